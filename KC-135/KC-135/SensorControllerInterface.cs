@@ -14,5 +14,41 @@ namespace KC_135
 
         [DllImport("SensorController.dll", CallingConvention = CallingConvention.Cdecl)]
         public static extern bool IsRunning();
+
+        public const uint InvalidSensorId = uint.MaxValue;
+
+        [DllImport("SensorController.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint GetSensorCount();
+
+        // Returns InvalidSensorId if no sensor has this name
+        [DllImport("SensorController.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern uint FindSensorId(string name);
+
+        // state is the numeric SensorState (0 = Off ... 4 = Degraded)
+        [DllImport("SensorController.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool SetSensorState(uint sensorId, byte state);
+
+        // Blittable arrays are pinned for the duration of the call, so a whole frame of
+        // updates or a full snapshot costs one transition and no marshalling copies
+        [DllImport("SensorController.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern UIntPtr SetSensorStates(uint[] sensorIds, byte[] states, UIntPtr count);
+
+        // Returns the total sensor count; grow the buffer and call again if it exceeds states.Length
+        [DllImport("SensorController.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern UIntPtr GetSensorSnapshot(byte[] states, UIntPtr capacity, out ulong generation);
+
+        // Prometheus-format metrics text; returns the full length, so grow the buffer and call
+        // again if it is not smaller than text.Length
+        [DllImport("SensorController.dll", CallingConvention = CallingConvention.Cdecl)]
+        public static extern UIntPtr GetMetricsText(byte[] text, UIntPtr capacity);
+
+        [DllImport("SensorController.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern ulong GetMetricCounter(string name);
+
+        // Port 0 stops the endpoint
+        [DllImport("SensorController.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool EnableMetricsEndpoint(ushort port);
     }
 }
\ No newline at end of file
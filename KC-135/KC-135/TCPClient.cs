@@ -1,30 +1,59 @@
 using System;
+using System.Collections.Generic;
 using System.Net.Sockets;
 using System.Text;
+using System.Text.RegularExpressions;
 using System.Threading;
 using System.Threading.Tasks;
 
 namespace KC_135
 {
+    // Encoding requested from the backend; Binary is negotiated with a HELLO line on connect
+    public enum StatusProtocol
+    {
+        Json,
+        Binary
+    }
+
     public class TCPClient
     {
+        // Binary frame types, see sensorSimBackend/BinaryProtocol.h
+        private const byte FrameDictionary = 1;
+        private const byte FrameSnapshot = 2;
+        private const byte FrameDelta = 3;
+        private const byte FrameSparseSnapshot = 4;
+
         private TcpClient tcpClient;
         private NetworkStream stream;
         private Thread receiveThread;
         private bool isConnected;
         private string serverIP;
         private int serverPort;
+        private StatusProtocol protocol;
+        private string subscription;
+        // Binary protocol: stream id and sequence of the last frame, to resume after a reconnect
+        private string streamId;
+        private ulong lastSequence;
         
         public event Action<string> MessageReceived;
+        // Binary protocol: sensor id -> (name, location), sent once and again when sensors are added
+        public event Action<Dictionary<uint, (string Name, string Location)>> SensorDictionaryReceived;
+        // Binary protocol: isKeyframe, unix time in ms, (sensor id, SensorState value) pairs
+        public event Action<bool, long, List<(uint Id, byte State)>> SensorStatesReceived;
         public event Action Connected;
         public event Action Disconnected;
         
         public bool IsConnected => isConnected && tcpClient?.Connected == true;
+        public ulong LastSequence => lastSequence;
         
-        public TCPClient(string serverIP = "127.0.0.1", int serverPort = 8080)
+        public TCPClient(string serverIP = "127.0.0.1", int serverPort = 8080,
+                         StatusProtocol protocol = StatusProtocol.Json, string subscription = null)
         {
             this.serverIP = serverIP;
             this.serverPort = serverPort;
+            this.protocol = protocol;
+            // Optional server-side filter, e.g. "location=Wing_* states=!Operational"
+            this.subscription = subscription;
         }
         
         public async Task<bool> ConnectAsync()
@@ -39,8 +68,19 @@ namespace KC_135
                     stream = tcpClient.GetStream();
                     isConnected = true;
                     
+                    if (protocol == StatusProtocol.Binary || !string.IsNullOrEmpty(subscription))
+                    {
+                        string line = "HELLO";
+                        if (protocol == StatusProtocol.Binary) line += " protocol=binary";
+                        if (!string.IsNullOrEmpty(subscription)) line += " " + subscription;
+                        // Only what changed while disconnected is sent back, if the server still has it
+                        if (protocol == StatusProtocol.Binary && streamId != null) line += $" resume={streamId}:{lastSequence}";
+                        byte[] hello = Encoding.ASCII.GetBytes(line + "\n");
+                        stream.Write(hello, 0, hello.Length);
+                    }
+                    
                     // Start receiving messages
-                    receiveThread = new Thread(ReceiveMessages)
+                    receiveThread = new Thread(protocol == StatusProtocol.Binary ? ReceiveBinaryFrames : ReceiveMessages)
                     {
                         IsBackground = true
                     };
@@ -115,6 +155,127 @@ namespace KC_135
             }
         }
         
+        private void ReceiveBinaryFrames()
+        {
+            byte[] buffer = new byte[64 * 1024];
+            int count = 0;
+            bool switched = false;
+            
+            while (isConnected && tcpClient?.Connected == true)
+            {
+                try
+                {
+                    if (count == buffer.Length)
+                    {
+                        Array.Resize(ref buffer, buffer.Length * 2);
+                    }
+                    
+                    int bytesRead = stream.Read(buffer, count, buffer.Length - count);
+                    if (bytesRead == 0)
+                    {
+                        // Server closed connection
+                        break;
+                    }
+                    count += bytesRead;
+                    
+                    int offset = 0;
+                    
+                    // JSON lines precede the hello acknowledgement; binary frames follow it
+                    while (!switched)
+                    {
+                        int newline = Array.IndexOf(buffer, (byte)'\n', offset, count - offset);
+                        if (newline < 0) break;
+                        string line = Encoding.UTF8.GetString(buffer, offset, newline - offset);
+                        offset = newline + 1;
+                        switched = line.Contains("\"type\":\"hello\"");
+                        if (switched)
+                        {
+                            Match streamMatch = Regex.Match(line, "\"stream\":(\\d+)");
+                            Match sequenceMatch = Regex.Match(line, "\"seq\":(\\d+)");
+                            if (streamMatch.Success && sequenceMatch.Success)
+                            {
+                                streamId = streamMatch.Groups[1].Value;
+                                lastSequence = ulong.Parse(sequenceMatch.Groups[1].Value);
+                            }
+                        }
+                    }
+                    
+                    while (switched && count - offset >= 4)
+                    {
+                        int length = (int)BitConverter.ToUInt32(buffer, offset);
+                        if (count - offset - 4 < length) break;
+                        ParseBinaryFrame(buffer, offset + 4, length);
+                        offset += 4 + length;
+                    }
+                    
+                    Buffer.BlockCopy(buffer, offset, buffer, 0, count - offset);
+                    count -= offset;
+                }
+                catch (Exception ex)
+                {
+                    if (isConnected)
+                    {
+                        Console.WriteLine($"Error receiving message: {ex.Message}");
+                    }
+                    break;
+                }
+            }
+            
+            if (isConnected)
+            {
+                isConnected = false;
+                Disconnected?.Invoke();
+            }
+        }
+        
+        private void ParseBinaryFrame(byte[] buffer, int offset, int length)
+        {
+            byte type = buffer[offset];
+            int pos = offset + 1;
+            
+            if (type == FrameDictionary)
+            {
+                uint sensorCount = BitConverter.ToUInt32(buffer, pos);
+                pos += 4;
+                var dictionary = new Dictionary<uint, (string Name, string Location)>();
+                for (uint i = 0; i < sensorCount; i++)
+                {
+                    uint id = BitConverter.ToUInt32(buffer, pos);
+                    int nameLength = BitConverter.ToUInt16(buffer, pos + 4);
+                    string name = Encoding.UTF8.GetString(buffer, pos + 6, nameLength);
+                    pos += 6 + nameLength;
+                    int locationLength = BitConverter.ToUInt16(buffer, pos);
+                    string location = Encoding.UTF8.GetString(buffer, pos + 2, locationLength);
+                    pos += 2 + locationLength;
+                    dictionary[id] = (name, location);
+                }
+                SensorDictionaryReceived?.Invoke(dictionary);
+            }
+            else if (type == FrameSnapshot || type == FrameDelta || type == FrameSparseSnapshot)
+            {
+                long timestampMs = BitConverter.ToInt64(buffer, pos);
+                lastSequence = BitConverter.ToUInt64(buffer, pos + 8);
+                uint sensorCount = BitConverter.ToUInt32(buffer, pos + 16);
+                pos += 20;
+                var states = new List<(uint Id, byte State)>((int)sensorCount);
+                for (uint i = 0; i < sensorCount; i++)
+                {
+                    if (type == FrameSnapshot)
+                    {
+                        states.Add((i, buffer[pos++]));
+                    }
+                    else
+                    {
+                        states.Add((BitConverter.ToUInt32(buffer, pos), buffer[pos + 4]));
+                        pos += 5;
+                    }
+                }
+                // A sparse snapshot (filtered subscription) is a keyframe covering only the listed ids
+                SensorStatesReceived?.Invoke(type != FrameDelta, timestampMs, states);
+            }
+            // Unknown frame types are skipped so the server can add new ones
+        }
+        
         public bool SendMessage(string message)
         {
             if (!IsConnected) return false;
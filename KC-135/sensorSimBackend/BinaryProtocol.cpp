@@ -0,0 +1,105 @@
+#include "BinaryProtocol.h"
+#include <algorithm>
+
+std::string BinaryProtocol::encodeDictionary(const SensorRegistry& sensors, const std::vector<SensorId>* subset) {
+    std::string frame;
+    beginFrame(frame, Dictionary);
+    size_t count = subset ? subset->size() : sensors.size();
+    appendU32(frame, (uint32_t)count);
+
+    for (size_t i = 0; i < count; ++i) {
+        SensorId id = subset ? (*subset)[i] : (SensorId)i;
+        std::string_view name = sensors.getName(id);
+        const std::string& location = sensors.getLocation(id);
+        uint16_t nameLen = (uint16_t)std::min<size_t>(name.size(), UINT16_MAX);
+        uint16_t locationLen = (uint16_t)std::min<size_t>(location.size(), UINT16_MAX);
+
+        appendU32(frame, id);
+        appendU16(frame, nameLen);
+        frame.append(name.data(), nameLen);
+        appendU16(frame, locationLen);
+        frame.append(location.data(), locationLen);
+    }
+
+    endFrame(frame);
+    return frame;
+}
+
+std::string BinaryProtocol::encodeSnapshot(const SensorRegistry& sensors, int64_t timestampMs, uint64_t sequence) {
+    std::string frame;
+    frame.reserve(HEADER_SIZE + 20 + sensors.size());
+    beginFrame(frame, Snapshot);
+    appendI64(frame, timestampMs);
+    appendU64(frame, sequence);
+    appendU32(frame, (uint32_t)sensors.size());
+
+    // The registry's state array already is the wire format
+    frame.append((const char*)sensors.stateData(), sensors.size());
+
+    endFrame(frame);
+    return frame;
+}
+
+std::string BinaryProtocol::encodeSparseSnapshot(const SensorRegistry& sensors, const std::vector<SensorId>& ids,
+                                                 int64_t timestampMs, uint64_t sequence) {
+    return encodeStateList(SparseSnapshot, sensors, ids, timestampMs, sequence);
+}
+
+std::string BinaryProtocol::encodeDelta(const SensorRegistry& sensors, const std::vector<SensorId>& changed,
+                                        int64_t timestampMs, uint64_t sequence) {
+    return encodeStateList(Delta, sensors, changed, timestampMs, sequence);
+}
+
+std::string BinaryProtocol::encodeStateList(FrameType type, const SensorRegistry& sensors,
+                                            const std::vector<SensorId>& ids, int64_t timestampMs,
+                                            uint64_t sequence) {
+    std::string frame;
+    frame.reserve(HEADER_SIZE + 20 + ids.size() * 5);
+    beginFrame(frame, type);
+    appendI64(frame, timestampMs);
+    appendU64(frame, sequence);
+    appendU32(frame, (uint32_t)ids.size());
+
+    const uint8_t* states = sensors.stateData();
+    for (SensorId id : ids) {
+        appendU32(frame, id);
+        frame.push_back((char)states[id]);
+    }
+
+    endFrame(frame);
+    return frame;
+}
+
+void BinaryProtocol::beginFrame(std::string& frame, FrameType type) {
+    // Length is patched in endFrame once the body is known
+    appendU32(frame, 0);
+    frame.push_back((char)type);
+}
+
+void BinaryProtocol::endFrame(std::string& frame) {
+    uint32_t length = (uint32_t)(frame.size() - 4);
+    for (int i = 0; i < 4; ++i) {
+        frame[i] = (char)((length >> (8 * i)) & 0xFF);
+    }
+}
+
+void BinaryProtocol::appendU16(std::string& frame, uint16_t value) {
+    frame.push_back((char)(value & 0xFF));
+    frame.push_back((char)((value >> 8) & 0xFF));
+}
+
+void BinaryProtocol::appendU32(std::string& frame, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        frame.push_back((char)((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void BinaryProtocol::appendI64(std::string& frame, int64_t value) {
+    appendU64(frame, (uint64_t)value);
+}
+
+void BinaryProtocol::appendU64(std::string& frame, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        frame.push_back((char)((value >> (8 * i)) & 0xFF));
+    }
+}
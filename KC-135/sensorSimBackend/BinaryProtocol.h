@@ -0,0 +1,56 @@
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "SensorRegistry.h"
+
+// Compact status encoding a client can opt into by sending "HELLO protocol=binary\n".
+//
+// Every frame is   [u32 length][u8 type][body]   where length counts type + body.
+// All integers are little-endian. Sensor IDs are the SensorRegistry IDs.
+//
+//   Dictionary      u32 count, count x { u32 id, u16 nameLen, name, u16 locationLen, location }
+//   Snapshot        i64 unix time ms, u64 seq, u32 count, count x u8 state   (state of sensor id i at offset i)
+//   Delta           i64 unix time ms, u64 seq, u32 count, count x { u32 id, u8 state }
+//   SparseSnapshot  same layout as Delta, listing every sensor that passes the client's filter
+//
+// seq is the server's stream position: each delta carries the sequence of the broadcast it
+// belongs to and a snapshot the sequence it is current to. It only ever increases.
+//
+// The dictionary is sent once after the switch and again only when sensors are added.
+// Clients with a subscription filter get a dictionary of just the sensors their filter can
+// select, and sparse snapshots listing only the sensors that currently pass it.
+class BinaryProtocol {
+public:
+    enum FrameType : uint8_t {
+        Dictionary = 1,
+        Snapshot   = 2,
+        Delta      = 3,
+        SparseSnapshot = 4,
+        Compressed = 5   // Wraps any frame for "HELLO compress=deflate" clients, see FrameCompressor.h
+    };
+
+    static const size_t HEADER_SIZE = 5;
+
+    // With subset, only those sensors are listed
+    static std::string encodeDictionary(const SensorRegistry& sensors, const std::vector<SensorId>* subset = nullptr);
+    static std::string encodeSnapshot(const SensorRegistry& sensors, int64_t timestampMs, uint64_t sequence);
+    static std::string encodeSparseSnapshot(const SensorRegistry& sensors, const std::vector<SensorId>& ids,
+                                            int64_t timestampMs, uint64_t sequence);
+    static std::string encodeDelta(const SensorRegistry& sensors, const std::vector<SensorId>& changed,
+                                   int64_t timestampMs, uint64_t sequence);
+
+private:
+    static std::string encodeStateList(FrameType type, const SensorRegistry& sensors,
+                                       const std::vector<SensorId>& ids, int64_t timestampMs, uint64_t sequence);
+    static void beginFrame(std::string& frame, FrameType type);
+    static void endFrame(std::string& frame);
+    static void appendU16(std::string& frame, uint16_t value);
+    static void appendU32(std::string& frame, uint32_t value);
+    static void appendI64(std::string& frame, int64_t value);
+    static void appendU64(std::string& frame, uint64_t value);
+};
+
+#endif // BINARY_PROTOCOL_H
@@ -0,0 +1,108 @@
+#include "ChangeDamper.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cmath>
+
+ChangeDamper::ChangeDamper()
+    : window(0), halfLife(0), suppressAt(0), reuseBelow(0), maxPenalty(0), nextCookie(1) {
+}
+
+void ChangeDamper::setWindow(std::chrono::milliseconds length) {
+    window = std::max(length, std::chrono::milliseconds(0));
+}
+
+void ChangeDamper::setFlapDamping(std::chrono::milliseconds life, double suppress, double reuse,
+                                  std::chrono::milliseconds maxSuppress) {
+    if (life.count() <= 0 || suppress <= 0) {
+        halfLife = std::chrono::nanoseconds(0);
+        return;
+    }
+    halfLife = life;
+    suppressAt = suppress;
+    reuseBelow = std::min(std::max(reuse, 0.01), suppress);
+    // Decays from the cap to reuseBelow in exactly maxSuppress
+    double halvings = std::max(0.0, std::chrono::duration<double>(maxSuppress).count() /
+                                    std::chrono::duration<double>(life).count());
+    maxPenalty = std::max(suppressAt, reuseBelow * std::exp2(halvings));
+}
+
+void ChangeDamper::decay(SensorDamping& damping, TimerWheel::Clock::time_point now) {
+    if (damping.penalty > 0 && now > damping.decayedAt) {
+        double halvings = std::chrono::duration<double>(now - damping.decayedAt).count() /
+                          std::chrono::duration<double>(halfLife).count();
+        damping.penalty *= std::exp2(-halvings);
+    }
+    damping.decayedAt = now;
+}
+
+// Until the penalty has decayed below reuseBelow
+std::chrono::nanoseconds ChangeDamper::reuseDelay(const SensorDamping& damping) const {
+    double halvings = std::log2(damping.penalty / reuseBelow);
+    auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(halfLife * std::max(halvings, 0.0));
+    return std::max(delay, std::chrono::nanoseconds(std::chrono::milliseconds(1)));
+}
+
+void ChangeDamper::hold(SensorId id, SensorDamping& damping, TimerWheel::Clock::time_point until) {
+    damping.held = true;
+    damping.cookie = nextCookie++;
+    releases.schedule(id, damping.cookie, until);
+}
+
+void ChangeDamper::filter(const std::vector<SensorId>& changed, const std::vector<uint32_t>& transitions,
+                          TimerWheel::Clock::time_point now, std::vector<SensorId>& ready) {
+    uint64_t coalesced = 0;
+    uint64_t suppressed = 0;
+    for (size_t i = 0; i < changed.size(); ++i) {
+        SensorId id = changed[i];
+        uint32_t count = std::max<uint32_t>(transitions[i], 1);
+        if (id >= sensors.size()) sensors.resize((size_t)id + 1);
+        SensorDamping& damping = sensors[id];
+
+        if (halfLife.count() > 0) {
+            decay(damping, now);
+            damping.penalty = std::min(damping.penalty + count, maxPenalty);
+            if (!damping.suppressed && damping.penalty >= suppressAt) {
+                damping.suppressed = true;
+                Metrics::add(MetricCounter::SensorsSuppressed);
+            }
+        }
+
+        // Exactly one of the transitions held now reaches clients when the sensor is released
+        uint64_t merged = damping.held ? count : count - 1;
+        if (damping.suppressed) {
+            // A timer already armed is pushed back on expiry if the penalty has grown since
+            suppressed += merged;
+            if (!damping.held) hold(id, damping, now + reuseDelay(damping));
+        } else if (now < damping.nextSend) {
+            coalesced += merged;
+            if (!damping.held) hold(id, damping, damping.nextSend);
+        } else {
+            coalesced += count - 1;
+            damping.nextSend = now + window;
+            ready.push_back(id);
+        }
+    }
+    if (coalesced > 0) Metrics::add(MetricCounter::StateChangesCoalesced, coalesced);
+    if (suppressed > 0) Metrics::add(MetricCounter::StateChangesSuppressed, suppressed);
+}
+
+void ChangeDamper::release(TimerWheel::Clock::time_point now, std::vector<SensorId>& ready) {
+    std::vector<TimerWheel::Timer> expired;
+    releases.expire(now, expired);
+    for (const TimerWheel::Timer& timer : expired) {
+        SensorDamping& damping = sensors[(size_t)timer.id];
+        if (!damping.held || damping.cookie != timer.cookie) continue;
+
+        if (damping.suppressed) {
+            decay(damping, now);
+            if (damping.penalty >= reuseBelow) {
+                hold((SensorId)timer.id, damping, now + reuseDelay(damping));
+                continue;
+            }
+            damping.suppressed = false;
+        }
+        damping.held = false;
+        damping.nextSend = now + window;
+        ready.push_back((SensorId)timer.id);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef CHANGE_DAMPER_H
+#define CHANGE_DAMPER_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "SensorRegistry.h"
+#include "TimerWheel.h"
+
+// Bounds how often each sensor's changes are broadcast, however fast its state changes.
+//
+// Coalescing: after a sensor is sent, its further changes are held until window has passed
+// and then sent once, with whatever state it has by then.
+//
+// Flap damping: every transition adds 1 to a per-sensor penalty that halves every halfLife.
+// A sensor whose penalty reaches suppressAt is held until the penalty decays below reuseBelow
+// (hysteresis, so it does not toggle in and out of damping) and then sent once with its latest
+// state. The penalty is capped so no sensor stays suppressed longer than maxSuppress.
+//
+// Held changes are never lost: each sensor is sent with its current state when released.
+// Not thread-safe; the primary shard owns it.
+class ChangeDamper {
+private:
+    struct SensorDamping {
+        double penalty = 0;
+        TimerWheel::Clock::time_point decayedAt;
+        TimerWheel::Clock::time_point nextSend;  // End of the coalescing window
+        uint64_t cookie = 0;                     // Only the timer carrying this one is live
+        bool held = false;
+        bool suppressed = false;
+    };
+
+    std::chrono::nanoseconds window;
+    std::chrono::nanoseconds halfLife;   // Zero disables flap damping
+    double suppressAt;
+    double reuseBelow;
+    double maxPenalty;
+    std::vector<SensorDamping> sensors;
+    TimerWheel releases;
+    uint64_t nextCookie;
+
+    void decay(SensorDamping& damping, TimerWheel::Clock::time_point now);
+    std::chrono::nanoseconds reuseDelay(const SensorDamping& damping) const;
+    void hold(SensorId id, SensorDamping& damping, TimerWheel::Clock::time_point until);
+
+public:
+    ChangeDamper();
+
+    void setWindow(std::chrono::milliseconds window);
+    void setFlapDamping(std::chrono::milliseconds halfLife, double suppressAt, double reuseBelow,
+                        std::chrono::milliseconds maxSuppress);
+    bool isEnabled() const { return window.count() > 0 || halfLife.count() > 0; }
+
+    // transitions[i] is how many times changed[i] changed state since it was last queued.
+    // Appends the sensors to send now to ready and holds the rest.
+    void filter(const std::vector<SensorId>& changed, const std::vector<uint32_t>& transitions,
+                TimerWheel::Clock::time_point now, std::vector<SensorId>& ready);
+    // Appends held sensors whose window or suppression is over
+    void release(TimerWheel::Clock::time_point now, std::vector<SensorId>& ready);
+    bool nextDeadline(TimerWheel::Clock::time_point& deadline) const { return releases.nextDeadline(deadline); }
+};
+
+#endif // CHANGE_DAMPER_H
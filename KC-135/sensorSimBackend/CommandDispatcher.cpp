@@ -0,0 +1,106 @@
+#include "CommandDispatcher.h"
+#include "Metrics.h"
+#include "TCPServer.h"
+#include <iostream>
+
+CommandDispatcher::CommandDispatcher(UDPSocketListener& listener, TCPServer& server)
+    : listener(listener), server(server), isDispatching(false), simulationRunning(true),
+      shutdownRequested(false) {
+}
+
+CommandDispatcher::~CommandDispatcher() {
+    stop();
+}
+
+bool CommandDispatcher::start() {
+    if (isDispatching) return false;
+    batch.reserve(UDPSocketListener::RECEIVE_BATCH);
+    isDispatching = true;
+    dispatchThread = std::thread(&CommandDispatcher::dispatchLoop, this);
+    return true;
+}
+
+void CommandDispatcher::stop() {
+    isDispatching = false;
+    if (dispatchThread.joinable()) {
+        dispatchThread.join();
+    }
+}
+
+bool CommandDispatcher::waitForShutdown(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(shutdownMutex);
+    return shutdownSignal.wait_for(lock, timeout, [this] { return shutdownRequested; });
+}
+
+void CommandDispatcher::dispatchLoop() {
+    while (isDispatching) {
+        // Bounded so stop() is noticed
+        if (!listener.waitForMessages(std::chrono::milliseconds(100))) continue;
+
+        batch.clear();
+        listener.drain(batch, UDPSocketListener::RECEIVE_BATCH);
+
+        std::chrono::steady_clock::time_point firstUpdate;
+        uint64_t malformed = 0;
+        for (const UdpDatagram& datagram : batch) {
+            if (UdpCommandProtocol::isStateUpdate(datagram.data, datagram.size)) {
+                size_t count = UdpCommandProtocol::stateUpdateCount(datagram.data, datagram.size);
+                if (count == 0) {
+                    malformed++;
+                    continue;
+                }
+                if (updateIds.empty()) firstUpdate = datagram.receivedAt;
+                for (size_t i = 0; i < count; ++i) {
+                    uint32_t id;
+                    uint8_t state;
+                    UdpCommandProtocol::stateUpdateEntry(datagram.data, i, id, state);
+                    updateIds.push_back(id);
+                    updateStates.push_back(state);
+                }
+                continue;
+            }
+
+            UdpCommandProtocol::Command command;
+            if (!UdpCommandProtocol::decodeCommand(datagram.data, datagram.size, command)) {
+                malformed++;
+                continue;
+            }
+            flushUpdates(firstUpdate);
+            applyCommand(command);
+        }
+        flushUpdates(firstUpdate);
+        listener.releaseDatagrams(batch);
+
+        if (malformed > 0) Metrics::add(MetricCounter::UdpDatagramsMalformed, malformed);
+    }
+}
+
+void CommandDispatcher::flushUpdates(std::chrono::steady_clock::time_point receivedAt) {
+    if (updateIds.empty()) return;
+    size_t applied = server.setSensorStates(updateIds.data(), updateStates.data(), updateIds.size(), receivedAt,
+                                            changedIds);
+    Metrics::add(MetricCounter::UdpStateUpdatesApplied, applied);
+    updateIds.clear();
+    updateStates.clear();
+}
+
+void CommandDispatcher::applyCommand(UdpCommandProtocol::Command command) {
+    Metrics::add(MetricCounter::UdpCommandsApplied);
+    switch (command) {
+        case UdpCommandProtocol::Start:
+            simulationRunning = true;
+            std::cout << "UDP command: START" << std::endl;
+            break;
+        case UdpCommandProtocol::Stop:
+            simulationRunning = false;
+            std::cout << "UDP command: STOP" << std::endl;
+            break;
+        case UdpCommandProtocol::Shutdown: {
+            std::cout << "UDP command: SHUTDOWN" << std::endl;
+            std::lock_guard<std::mutex> lock(shutdownMutex);
+            shutdownRequested = true;
+            shutdownSignal.notify_all();
+            break;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef COMMAND_DISPATCHER_H
+#define COMMAND_DISPATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "SensorRegistry.h"
+#include "UDPSocketListener.h"
+#include "UdpCommandProtocol.h"
+
+class TCPServer;
+
+// Applies the commands and sensor state updates a UDPSocketListener receives, see
+// UdpCommandProtocol.h, on a thread of its own.
+//
+// Datagrams are drained in batches and decoded straight from the listener's ring. All state
+// updates in a batch are applied to the server as one setSensorStates() call, so a burst costs
+// one broadcast wakeup. A command first flushes the updates received before it.
+//
+// START and STOP switch isSimulationRunning(), which SensorControllerApp uses to pause its own
+// simulated changes while a test stand drives the sensors. SHUTDOWN wakes waitForShutdown().
+class CommandDispatcher {
+private:
+    UDPSocketListener& listener;
+    TCPServer& server;
+    std::thread dispatchThread;
+    std::atomic<bool> isDispatching;
+    std::atomic<bool> simulationRunning;
+    bool shutdownRequested;   // Guarded by shutdownMutex
+    std::mutex shutdownMutex;
+    std::condition_variable shutdownSignal;
+
+    // Reused from batch to batch by the dispatch thread
+    std::vector<UdpDatagram> batch;
+    std::vector<SensorId> updateIds;
+    std::vector<uint8_t> updateStates;
+    std::vector<SensorId> changedIds;
+
+    void dispatchLoop();
+    void flushUpdates(std::chrono::steady_clock::time_point receivedAt);
+    void applyCommand(UdpCommandProtocol::Command command);
+
+public:
+    CommandDispatcher(UDPSocketListener& listener, TCPServer& server);
+    ~CommandDispatcher();
+
+    CommandDispatcher(const CommandDispatcher&) = delete;
+    CommandDispatcher& operator=(const CommandDispatcher&) = delete;
+
+    // The listener must be open
+    bool start();
+    void stop();
+
+    bool isSimulationRunning() const { return simulationRunning; }
+    // True once SHUTDOWN has been received, false if timeout passes first
+    bool waitForShutdown(std::chrono::milliseconds timeout);
+};
+
+#endif // COMMAND_DISPATCHER_H
@@ -0,0 +1,79 @@
+#include "DatagramRing.h"
+
+DatagramRing::DatagramRing() : slotSize(0), mask(0), readPosition(0), writePosition(0) {
+    create(1, 0);
+}
+
+void DatagramRing::create(size_t count, size_t bytes) {
+    size_t rounded = 1;
+    while (rounded < count) rounded <<= 1;
+
+    cells.reset(new Cell[rounded]);
+    for (size_t i = 0; i < rounded; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+        cells[i].length = 0;
+    }
+    slotSize = bytes;
+    memory.assign(rounded * (slotSize + 1), 0);
+    mask = rounded - 1;
+    readPosition.store(0, std::memory_order_relaxed);
+    writePosition.store(0, std::memory_order_release);
+}
+
+size_t DatagramRing::size() const {
+    uint64_t read = readPosition.load(std::memory_order_relaxed);
+    uint64_t written = writePosition.load(std::memory_order_acquire);
+    return written > read ? (size_t)(written - read) : 0;
+}
+
+void DatagramRing::publish(uint64_t position, uint32_t length, std::chrono::steady_clock::time_point receivedAt,
+                           std::chrono::steady_clock::time_point queuedAt) {
+    Cell& target = cell(position);
+    target.length = length;
+    target.receivedAt = receivedAt;
+    target.queuedAt = queuedAt;
+    target.sequence.store(position + 1, std::memory_order_release);
+    writePosition.store(position + 1, std::memory_order_release);
+}
+
+bool DatagramRing::reclaimOldest(uint64_t position) {
+    uint64_t oldest = position - capacity();
+    if (position < capacity() || cell(oldest).sequence.load(std::memory_order_acquire) != oldest + 1) {
+        return false;
+    }
+    if (!readPosition.compare_exchange_strong(oldest, oldest + 1, std::memory_order_relaxed)) {
+        return false;
+    }
+    release(oldest);
+    return true;
+}
+
+size_t DatagramRing::claimBatch(uint64_t& first, size_t max) {
+    if (max == 0) return 0;
+    uint64_t next = readPosition.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t sequence = cell(next).sequence.load(std::memory_order_acquire);
+        int64_t waiting = (int64_t)(sequence - (next + 1));
+        if (waiting < 0) {
+            return 0;
+        }
+        if (waiting > 0) {
+            // Another consumer took this position
+            next = readPosition.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        size_t count = 1;
+        while (count < max && cell(next + count).sequence.load(std::memory_order_acquire) == next + count + 1) {
+            count++;
+        }
+        if (readPosition.compare_exchange_weak(next, next + count, std::memory_order_relaxed)) {
+            first = next;
+            return count;
+        }
+    }
+}
+
+void DatagramRing::release(uint64_t position) {
+    cell(position).sequence.store(position + mask + 1, std::memory_order_release);
+}
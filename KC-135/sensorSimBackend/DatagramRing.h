@@ -0,0 +1,86 @@
+#ifndef DATAGRAM_RING_H
+#define DATAGRAM_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <netinet/in.h>
+#endif
+
+// Bounded lock-free ring of datagram slots, filled by one receive thread and read in place by
+// any number of consumers.
+//
+// Every cell carries a sequence number, as in Vyukov's bounded queue. For the position p that
+// maps to a cell, sequence p means free for the producer, p + 1 means filled and waiting, and
+// a consumer that has claimed it stores p + capacity once done, freeing it for the next lap.
+// The producer writes straight into free cells and publishes them with one release store;
+// consumers claim the oldest waiting position with a compare-and-swap.
+class DatagramRing {
+private:
+    struct alignas(64) Cell {
+        std::atomic<uint64_t> sequence;
+        uint32_t length;
+        sockaddr_in source;
+        std::chrono::steady_clock::time_point receivedAt;   // Arrival at the socket
+        std::chrono::steady_clock::time_point queuedAt;     // Publication to consumers
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::vector<char> memory;            // One slot of slotSize + 1 bytes per cell
+    size_t slotSize;
+    uint64_t mask;
+    alignas(64) std::atomic<uint64_t> readPosition;   // Next position a consumer claims
+    alignas(64) std::atomic<uint64_t> writePosition;  // Positions below this are published
+
+    Cell& cell(uint64_t position) { return cells[position & mask]; }
+    const Cell& cell(uint64_t position) const { return cells[position & mask]; }
+
+public:
+    // Length of a cell whose datagram was received but discarded; consumers skip it
+    static constexpr uint32_t SKIPPED = UINT32_MAX;
+
+    DatagramRing();
+
+    // Allocates and touches every slot; cells is rounded up to a power of two. Not safe while
+    // the ring is in use.
+    void create(size_t cells, size_t slotSize);
+    size_t capacity() const { return (size_t)mask + 1; }
+    // Published and not yet claimed; approximate while threads are running
+    size_t size() const;
+
+    // Producer side. Positions are filled in order, starting from 0.
+    bool isFree(uint64_t position) const {
+        return cell(position).sequence.load(std::memory_order_acquire) == position;
+    }
+    char* slotData(uint64_t position) { return memory.data() + (size_t)(position & mask) * (slotSize + 1); }
+    sockaddr_in& slotSource(uint64_t position) { return cell(position).source; }
+    void publish(uint64_t position, uint32_t length, std::chrono::steady_clock::time_point receivedAt,
+                 std::chrono::steady_clock::time_point queuedAt);
+    // Takes back the cell of position from the oldest waiting datagram, as if a consumer had
+    // claimed and released it. False if a consumer already holds it.
+    bool reclaimOldest(uint64_t position);
+
+    // Consumer side. A claimed position's slot stays valid until release().
+    bool claim(uint64_t& position) { return claimBatch(position, 1) == 1; }
+    // Claims up to max consecutive waiting positions with one compare-and-swap, starting at
+    // first; returns how many
+    size_t claimBatch(uint64_t& first, size_t max);
+    void release(uint64_t position);
+
+    // A published position's datagram, for its consumer or the producer
+    const char* data(uint64_t position) const {
+        return memory.data() + (size_t)(position & mask) * (slotSize + 1);
+    }
+    uint32_t length(uint64_t position) const { return cell(position).length; }
+    const sockaddr_in& source(uint64_t position) const { return cell(position).source; }
+    std::chrono::steady_clock::time_point receivedAt(uint64_t position) const { return cell(position).receivedAt; }
+    std::chrono::steady_clock::time_point queuedAt(uint64_t position) const { return cell(position).queuedAt; }
+};
+
+#endif // DATAGRAM_RING_H
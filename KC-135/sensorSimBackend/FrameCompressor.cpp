@@ -0,0 +1,98 @@
+#include "FrameCompressor.h"
+#include "BinaryProtocol.h"
+#include "Metrics.h"
+
+#ifdef SENSOR_HAVE_ZLIB
+    #include <zlib.h>
+#endif
+
+// Strings that recur in every status frame. deflate finds matches nearest the end of the
+// dictionary cheapest, so the most frequent ones come last. Changing this breaks clients.
+const char FrameCompressor::DICTIONARY[] =
+    "{\"type\":\"hello\",\"protocol\":\"binary\",\"compression\":\"deflate\",\"stream\":"
+    "\"resumed\":true,\"rate\":\"filter\":\"name=location=states=Sensor Nose Tail "
+    "\"server_status\":\"running\",\"connected_clients\":,\"sensors\":[]}\n"
+    "{\"type\":\"snapshot\",\"seq\":,\"timestamp\":\"Sun Mon Tue Wed Thu Fri Sat "
+    "Jan Feb Mar Apr May Jun Jul Aug Sep Oct Nov Dec \","
+    "{\"type\":\"delta\",\"seq\":,\"timestamp\":\"\",\"sensors\":["
+    "\",\"state\":\"Off\"},\",\"state\":\"Initializing\"},\",\"state\":\"Declaring\"},"
+    "\",\"state\":\"Degraded\"},{\"name\":\"Sensor\",\"location\":\"Wing_Left\",\"state\":\"Operational\"},"
+    "{\"name\":\"Sensor\",\"location\":\"Wing_Right\",\"state\":\"Operational\"},";
+const size_t FrameCompressor::DICTIONARY_SIZE = sizeof(FrameCompressor::DICTIONARY) - 1;
+
+#ifdef SENSOR_HAVE_ZLIB
+
+// Speed over ratio: a 1 Hz snapshot of thousands of sensors still shrinks well over 10x
+static const int COMPRESSION_LEVEL = 3;
+
+// One deflate state per thread, reset between frames instead of reallocated
+struct DeflateContext {
+    z_stream stream;
+    bool ready;
+
+    DeflateContext() : stream(), ready(false) {
+        ready = deflateInit2(&stream, COMPRESSION_LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~DeflateContext() {
+        if (ready) deflateEnd(&stream);
+    }
+};
+
+bool FrameCompressor::available() {
+    return true;
+}
+
+bool FrameCompressor::compress(const char* data, size_t size, std::string& out) {
+    static thread_local DeflateContext context;
+    if (!context.ready || size > 0xFFFFFFFFu) return false;
+
+    z_stream& stream = context.stream;
+    if (deflateReset(&stream) != Z_OK ||
+        deflateSetDictionary(&stream, (const Bytef*)DICTIONARY, (uInt)DICTIONARY_SIZE) != Z_OK) {
+        return false;
+    }
+
+    out.resize(BinaryProtocol::HEADER_SIZE + deflateBound(&stream, (uLong)size));
+    stream.next_in = (Bytef*)data;
+    stream.avail_in = (uInt)size;
+    stream.next_out = (Bytef*)&out[BinaryProtocol::HEADER_SIZE];
+    stream.avail_out = (uInt)(out.size() - BinaryProtocol::HEADER_SIZE);
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) return false;
+
+    out.resize(BinaryProtocol::HEADER_SIZE + stream.total_out);
+    uint32_t length = (uint32_t)(out.size() - 4);
+    for (int i = 0; i < 4; ++i) {
+        out[i] = (char)((length >> (8 * i)) & 0xFF);
+    }
+    out[4] = (char)BinaryProtocol::Compressed;
+    return true;
+}
+
+#else
+
+bool FrameCompressor::available() {
+    return false;
+}
+
+bool FrameCompressor::compress(const char*, size_t, std::string&) {
+    return false;
+}
+
+#endif // SENSOR_HAVE_ZLIB
+
+StatusFramePtr FrameCompressor::compressed(const StatusFramePtr& frame) {
+    std::call_once(frame->compressOnce, [&frame]() {
+        auto start = std::chrono::steady_clock::now();
+        std::string bytes;
+        if (!compress(frame->data(), frame->size(), bytes)) return;
+
+        Metrics::add(MetricCounter::FramesCompressed);
+        Metrics::add(MetricCounter::CompressionInputBytes, frame->size());
+        Metrics::add(MetricCounter::CompressionOutputBytes, bytes.size());
+        Metrics::record(MetricHistogram::CompressionNs, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        // Keeps the original's encode time so send latency still covers compression
+        frame->compressedCopy = std::make_shared<const StatusFrame>(std::move(bytes), frame->createdAt());
+    });
+    return frame->compressedCopy;
+}
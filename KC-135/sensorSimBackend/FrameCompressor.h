@@ -0,0 +1,36 @@
+#ifndef FRAME_COMPRESSOR_H
+#define FRAME_COMPRESSOR_H
+
+#include <string>
+#include "StatusFrame.h"
+
+// Deflate for clients that send "HELLO compress=deflate".
+//
+// After the hello acknowledgement every frame such a client receives is wrapped as
+//
+//   [u32 length][u8 type = 5][raw deflate stream]      (BinaryProtocol::Compressed)
+//
+// whatever its protocol: the stream inflates to exactly one JSON line or one binary frame.
+// Each frame is compressed on its own (raw deflate, window 15, ending with a final block)
+// against the preset dictionary below, so the common keys and state names cost a few bits
+// even in a small delta. Frames are independent because they are shared: the compressed copy
+// is built once per frame and queued to every compressing client, each of which may have
+// joined at a different point or had frames dropped. Clients inflate with the same
+// dictionary, e.g. Python's zlib.decompressobj(-15, zdict=FrameCompressor::DICTIONARY).
+class FrameCompressor {
+public:
+    static const char DICTIONARY[];
+    static const size_t DICTIONARY_SIZE;
+
+    // False when the backend was built without zlib; HELLO compress= is then ignored
+    static bool available();
+
+    // The compressed copy of frame, built by the first caller and shared by the rest.
+    // Thread-safe. Null if compression is unavailable or failed.
+    static StatusFramePtr compressed(const StatusFramePtr& frame);
+
+    // One wrapped frame holding data; false if compression is unavailable or failed
+    static bool compress(const char* data, size_t size, std::string& out);
+};
+
+#endif // FRAME_COMPRESSOR_H
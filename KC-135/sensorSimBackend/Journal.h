@@ -0,0 +1,95 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// On-disk layout of the sensor state journal, a directory of fixed-size segment files:
+//
+//   journal-<segment, 16 hex digits>.seg   [JournalSegmentHeader][time index][records]
+//   catalog-<run, 16 hex digits>.bin       names for the sensor IDs of one writer run
+//
+// Segments are numbered in write order and never modified once the writer moves on. Each
+// holds capacity fixed-size JournalRecords. Only the first committed are valid; the rest are
+// zero or were written after the last group commit and may not have reached the disk.
+//
+// The time index is a sparse array of int64 timestamps: entry i is the timestamp of record
+// i * JOURNAL_INDEX_STRIDE. Timestamps never decrease within a journal, so a reader finds a
+// time by picking the segment, then the index entry, then scanning at most one stride.
+//
+// Sensor IDs are only stable within one writer run, so each segment names the run it belongs
+// to, and catalog-<run>.bin lists that run's sensors as entries of
+// u32 id, u16 nameLen, name, u16 locationLen, location   (as in the binary dictionary frame).
+// Everything is little-endian host order.
+
+static const uint32_t JOURNAL_MAGIC = 0x4C4E524A;          // "JRNL"
+static const uint32_t JOURNAL_VERSION = 1;
+static const uint32_t JOURNAL_INDEX_STRIDE = 1024;         // Records per time index entry
+static const size_t JOURNAL_PAGE_SIZE = 4096;              // Records start on a page boundary
+
+struct JournalRecord {
+    int64_t timestampNs;     // Unix time of the broadcast that carried the change
+    uint32_t sensorId;
+    uint8_t oldState;        // SensorState values
+    uint8_t newState;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(JournalRecord) == 16, "journal records are 16 bytes on disk");
+
+struct JournalSegmentHeader {
+    std::atomic<uint32_t> magic;      // Written last, once the segment is initialised
+    uint32_t version;
+    uint64_t segment;
+    uint64_t run;                     // First segment number of the writer run, names its catalog
+    uint32_t capacity;                // Records the segment has room for
+    uint32_t indexEntries;
+    uint64_t recordsOffset;           // From the start of the file
+    std::atomic<uint64_t> committed;  // Records durable on disk; readers stop here
+};
+
+inline size_t journalAlign(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) & ~(alignment - 1);
+}
+
+inline size_t journalIndexOffset() {
+    return journalAlign(sizeof(JournalSegmentHeader), 64);
+}
+
+inline std::string journalFileName(const char* prefix, uint64_t number, const char* extension) {
+    static const char HEX[] = "0123456789abcdef";
+    std::string name(prefix);
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        name.push_back(HEX[(number >> shift) & 0xF]);
+    }
+    return name + extension;
+}
+
+// Number from a name made by journalFileName; false for any other file
+inline bool journalParseFileName(const std::string& name, const char* prefix, const char* extension, uint64_t& number) {
+    std::string head(prefix), tail(extension);
+    if (name.size() != head.size() + 16 + tail.size() || name.compare(0, head.size(), head) != 0 ||
+        name.compare(name.size() - tail.size(), tail.size(), tail) != 0) {
+        return false;
+    }
+    number = 0;
+    for (size_t i = head.size(); i < head.size() + 16; ++i) {
+        char c = name[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) return false;
+        number = (number << 4) | (uint64_t)digit;
+    }
+    return true;
+}
+
+inline std::string journalSegmentName(uint64_t segment) {
+    return journalFileName("journal-", segment, ".seg");
+}
+
+inline std::string journalCatalogName(uint64_t run) {
+    return journalFileName("catalog-", run, ".bin");
+}
+
+#endif // JOURNAL_H
@@ -0,0 +1,274 @@
+#include "JournalReader.h"
+#include "Sensor.h"
+#include "TCPServer.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+JournalReader::Segment::~Segment() {
+#ifndef _WIN32
+    if (mapping) munmap(mapping, size);
+#endif
+}
+
+JournalReader::JournalReader() : position(0), recordIndex(0) {
+}
+
+JournalReader::~JournalReader() {
+    close();
+}
+
+bool JournalReader::open(const std::string& path) {
+    close();
+    directory = path;
+    refresh();
+    if (segments.empty()) return false;
+    position = segments.begin()->first;
+    recordIndex = 0;
+    return true;
+}
+
+void JournalReader::close() {
+    segments.clear();
+    catalogs.clear();
+    catalogSizes.clear();
+    position = 0;
+    recordIndex = 0;
+}
+
+void JournalReader::refresh() {
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::string name = entry.path().filename().string();
+        uint64_t number;
+        if (journalParseFileName(name, "journal-", ".seg", number) && segments.find(number) == segments.end()) {
+            mapSegment(number, entry.path().string());
+        } else if (journalParseFileName(name, "catalog-", ".bin", number)) {
+            loadCatalog(number, entry.path().string());
+        }
+    }
+
+    for (auto& entry : segments) {
+        Segment& segment = *entry.second;
+        segment.committed = std::min<uint64_t>(segment.header->committed.load(std::memory_order_acquire),
+                                               segment.header->capacity);
+    }
+}
+
+bool JournalReader::mapSegment(uint64_t number, const std::string& path) {
+#ifdef _WIN32
+    (void)number;
+    (void)path;
+    return false;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < JOURNAL_PAGE_SIZE) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    std::unique_ptr<Segment> segment(new Segment());
+    segment->mapping = memory;
+    segment->size = size;
+
+    // A segment still being created, or from another version, is skipped until it validates
+    const JournalSegmentHeader* header = static_cast<const JournalSegmentHeader*>(memory);
+    if (header->magic.load(std::memory_order_acquire) != JOURNAL_MAGIC || header->version != JOURNAL_VERSION ||
+        header->segment != number ||
+        journalIndexOffset() + (size_t)header->indexEntries * sizeof(int64_t) > header->recordsOffset ||
+        header->indexEntries < (header->capacity + JOURNAL_INDEX_STRIDE - 1) / JOURNAL_INDEX_STRIDE ||
+        header->recordsOffset + (uint64_t)header->capacity * sizeof(JournalRecord) > size) {
+        return false;
+    }
+
+    segment->header = header;
+    segment->index = reinterpret_cast<const int64_t*>(static_cast<const char*>(memory) + journalIndexOffset());
+    segment->records = reinterpret_cast<const JournalRecord*>(static_cast<const char*>(memory) + header->recordsOffset);
+    segments[number] = std::move(segment);
+    return true;
+#endif
+}
+
+// Appended to while the writer runs, so only whole entries are taken and the rest is read later
+void JournalReader::loadCatalog(uint64_t run, const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return;
+    size_t& parsed = catalogSizes[run];
+    file.seekg((std::streamoff)parsed);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    auto readLE = [&bytes](size_t offset, int count) {
+        uint64_t value = 0;
+        for (int i = 0; i < count; ++i) {
+            value |= (uint64_t)(uint8_t)bytes[offset + i] << (8 * i);
+        }
+        return value;
+    };
+
+    std::map<SensorId, JournalSensor>& sensors = catalogs[run];
+    size_t offset = 0;
+    while (offset + 6 <= bytes.size()) {
+        SensorId id = (SensorId)readLE(offset, 4);
+        size_t nameLength = (size_t)readLE(offset + 4, 2);
+        if (offset + 8 + nameLength > bytes.size()) break;
+        size_t locationLength = (size_t)readLE(offset + 6 + nameLength, 2);
+        if (offset + 8 + nameLength + locationLength > bytes.size()) break;
+
+        JournalSensor& sensor = sensors[id];
+        sensor.name = bytes.substr(offset + 6, nameLength);
+        sensor.location = bytes.substr(offset + 8 + nameLength, locationLength);
+        offset += 8 + nameLength + locationLength;
+    }
+    parsed += offset;
+}
+
+const JournalSensor* JournalReader::findSensor(uint64_t run, SensorId id) const {
+    auto catalog = catalogs.find(run);
+    if (catalog == catalogs.end()) return nullptr;
+    auto sensor = catalog->second.find(id);
+    return sensor == catalog->second.end() ? nullptr : &sensor->second;
+}
+
+bool JournalReader::timeRange(int64_t& firstNs, int64_t& lastNs) const {
+    bool found = false;
+    for (const auto& entry : segments) {
+        const Segment& segment = *entry.second;
+        if (segment.committed == 0) continue;
+        if (!found) firstNs = segment.records[0].timestampNs;
+        lastNs = segment.records[segment.committed - 1].timestampNs;
+        found = true;
+    }
+    return found;
+}
+
+void JournalReader::seek(int64_t timestampNs) {
+    for (const auto& entry : segments) {
+        const Segment& segment = *entry.second;
+        if (segment.committed == 0 || segment.records[segment.committed - 1].timestampNs < timestampNs) continue;
+
+        // Last index entry before the time, then a scan of at most one stride
+        size_t entries = (size_t)((segment.committed + JOURNAL_INDEX_STRIDE - 1) / JOURNAL_INDEX_STRIDE);
+        size_t after = (size_t)(std::lower_bound(segment.index, segment.index + entries, timestampNs) - segment.index);
+        uint64_t record = after == 0 ? 0 : (uint64_t)(after - 1) * JOURNAL_INDEX_STRIDE;
+        while (segment.records[record].timestampNs < timestampNs) ++record;
+
+        position = entry.first;
+        recordIndex = record;
+        return;
+    }
+
+    // Past the end: the next record committed after a refresh
+    if (segments.empty()) return;
+    position = segments.rbegin()->first;
+    recordIndex = segments.rbegin()->second->committed;
+}
+
+bool JournalReader::next(JournalEntry& entry) {
+    for (auto it = segments.lower_bound(position); it != segments.end(); ++it) {
+        const Segment& segment = *it->second;
+        if (it->first != position) {
+            // Segments in between that never received a record, e.g. a crashed run's spare
+            if (segment.committed == 0) continue;
+            position = it->first;
+            recordIndex = 0;
+        }
+        if (recordIndex >= segment.committed) {
+            // The writer may still be filling this one; only move on once a later one has records
+            bool later = std::any_of(std::next(it), segments.end(),
+                                     [](const auto& other) { return other.second->committed > 0; });
+            if (!later) return false;
+            continue;
+        }
+
+        const JournalRecord& record = segment.records[recordIndex++];
+        entry.timestampNs = record.timestampNs;
+        entry.sensorId = record.sensorId;
+        entry.oldState = record.oldState;
+        entry.newState = record.newState;
+        entry.sensor = findSensor(segment.header->run, record.sensorId);
+        return true;
+    }
+    return false;
+}
+
+size_t JournalReader::replay(TCPServer& server, int64_t untilNs, double speed) {
+    // Sensors are matched to the server by name, since IDs differ between runs
+    std::unordered_map<const JournalSensor*, SensorId> serverIds;
+    auto serverId = [&](const JournalSensor* sensor) {
+        auto found = serverIds.find(sensor);
+        if (found != serverIds.end()) return found->second;
+        SensorId id = server.addSensor(Sensor(sensor->name, sensor->location));
+        serverIds.emplace(sensor, id);
+        return id;
+    };
+
+    // State as of the current position: the last change before it, or for a sensor that only
+    // changes later, the state that change started from
+    uint64_t startPosition = position;
+    uint64_t startRecord = recordIndex;
+    std::map<std::string, std::pair<const JournalSensor*, uint8_t>> initial;
+    JournalEntry entry;
+    if (!segments.empty()) {
+        position = segments.begin()->first;
+        recordIndex = 0;
+        while ((position < startPosition || (position == startPosition && recordIndex < startRecord)) && next(entry)) {
+            if (entry.sensor) initial[entry.sensor->name] = {entry.sensor, entry.newState};
+        }
+    }
+    position = startPosition;
+    recordIndex = startRecord;
+    while (next(entry) && entry.timestampNs <= untilNs) {
+        if (entry.sensor) initial.emplace(entry.sensor->name, std::make_pair(entry.sensor, entry.oldState));
+    }
+    position = startPosition;
+    recordIndex = startRecord;
+
+    for (const auto& sensor : initial) {
+        server.setSensorState(serverId(sensor.second.first), (SensorState)sensor.second.second);
+    }
+
+    size_t applied = 0;
+    auto wallStart = std::chrono::steady_clock::now();
+    int64_t journalStart = 0;
+    bool started = false;
+    while (true) {
+        uint64_t previousPosition = position;
+        uint64_t previousRecord = recordIndex;
+        if (!next(entry)) break;
+        if (entry.timestampNs > untilNs) {
+            // Left unread for a later call
+            position = previousPosition;
+            recordIndex = previousRecord;
+            break;
+        }
+        if (!started) {
+            journalStart = entry.timestampNs;
+            started = true;
+        }
+        if (speed > 0) {
+            auto offset = std::chrono::nanoseconds((int64_t)((double)(entry.timestampNs - journalStart) / speed));
+            std::this_thread::sleep_until(wallStart + offset);
+        }
+        if (entry.sensor && server.setSensorState(serverId(entry.sensor), (SensorState)entry.newState)) {
+            applied++;
+        }
+    }
+    return applied;
+}
@@ -0,0 +1,83 @@
+#ifndef JOURNAL_READER_H
+#define JOURNAL_READER_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Journal.h"
+#include "SensorRegistry.h"
+
+class TCPServer;
+
+struct JournalSensor {
+    std::string name;
+    std::string location;
+};
+
+struct JournalEntry {
+    int64_t timestampNs;
+    SensorId sensorId;             // As numbered by the writer run that recorded it
+    uint8_t oldState;
+    uint8_t newState;
+    const JournalSensor* sensor;   // Null if the catalog does not name it
+};
+
+// Reads a state journal written by JournalWriter, also while it is still being written.
+//
+// Segments are mapped read-only and records are read in place. seek() finds a time through
+// each segment's sparse index and scans at most one index stride. Only committed records are
+// returned; refresh() picks up what the writer has committed since. Not thread-safe.
+class JournalReader {
+private:
+    struct Segment {
+        void* mapping = nullptr;
+        size_t size = 0;
+        const JournalSegmentHeader* header = nullptr;
+        const int64_t* index = nullptr;
+        const JournalRecord* records = nullptr;
+        uint64_t committed = 0;
+
+        ~Segment();
+    };
+
+    std::string directory;
+    std::map<uint64_t, std::unique_ptr<Segment>> segments;                  // By segment number
+    std::map<uint64_t, std::map<SensorId, JournalSensor>> catalogs;         // By run
+    std::map<uint64_t, size_t> catalogSizes;                                // Bytes parsed so far
+    uint64_t position;        // Segment number of the next record
+    uint64_t recordIndex;     // Within that segment
+
+    bool mapSegment(uint64_t number, const std::string& path);
+    void loadCatalog(uint64_t run, const std::string& path);
+    const JournalSensor* findSensor(uint64_t run, SensorId id) const;
+
+public:
+    JournalReader();
+    ~JournalReader();
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    // Positioned at the oldest record. False if the directory holds no readable segment.
+    bool open(const std::string& directory);
+    void close();
+    // Picks up records and segments committed since open() or the last refresh
+    void refresh();
+
+    // Oldest and newest committed timestamps; false if the journal is empty
+    bool timeRange(int64_t& firstNs, int64_t& lastNs) const;
+
+    // Positions at the first record at or after timestampNs
+    void seek(int64_t timestampNs);
+    bool next(JournalEntry& entry);
+
+    // Replays the records from the current position up to untilNs into server, creating any
+    // sensor it does not have yet. Sensors first get their state as of the current position,
+    // then each change is applied with its original spacing divided by speed; speed 0 applies
+    // them as fast as possible. Returns the number of changes applied.
+    size_t replay(TCPServer& server, int64_t untilNs, double speed);
+};
+
+#endif // JOURNAL_READER_H
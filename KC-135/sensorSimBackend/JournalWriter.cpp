@@ -0,0 +1,351 @@
+#include "JournalWriter.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+// Smaller segments would be mostly header and index
+static const size_t MIN_SEGMENT_BYTES = 64 * 1024;
+static const size_t MAX_SEGMENT_BYTES = (size_t)1 << 30;
+
+JournalWriter::Segment::~Segment() {
+#ifndef _WIN32
+    if (mapping) munmap(mapping, size);
+#endif
+}
+
+JournalWriter::JournalWriter()
+    : segmentBytes(0), maxSegments(0), commitInterval(0), run(0), nextSegment(0), lastTimestampNs(0),
+      current(nullptr), catalog(nullptr), catalogDirty(false), stopping(false), opened(false) {
+}
+
+JournalWriter::~JournalWriter() {
+    close();
+}
+
+bool JournalWriter::open(const std::string& path, size_t bytes, size_t segmentsKept,
+                         std::chrono::milliseconds interval) {
+#ifdef _WIN32
+    (void)path;
+    (void)bytes;
+    (void)segmentsKept;
+    (void)interval;
+    std::cerr << "The state journal is not supported on this platform" << std::endl;
+    return false;
+#else
+    close();
+
+    std::error_code error;
+    std::filesystem::create_directories(path, error);
+    if (!std::filesystem::is_directory(path, error)) {
+        std::cerr << "Failed to create journal directory " << path << std::endl;
+        return false;
+    }
+
+    // A new run starts after whatever an earlier process left behind
+    uint64_t next = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+        uint64_t number;
+        if (journalParseFileName(entry.path().filename().string(), "journal-", ".seg", number)) {
+            next = std::max(next, number + 1);
+        }
+    }
+
+    directory = path;
+    segmentBytes = std::min(std::max(bytes, MIN_SEGMENT_BYTES), MAX_SEGMENT_BYTES);
+    maxSegments = std::max<size_t>(segmentsKept, 2);
+    commitInterval = std::max(interval, std::chrono::milliseconds(1));
+    run = next;
+    nextSegment = next;
+    lastTimestampNs = 0;
+    stopping = false;
+
+    std::string catalogPath = (std::filesystem::path(directory) / journalCatalogName(run)).string();
+    catalog = std::fopen(catalogPath.c_str(), "wb");
+    SegmentPtr first = catalog ? createSegment(nextSegment++) : nullptr;
+    SegmentPtr second = first ? createSegment(nextSegment++) : nullptr;
+    if (!second) {
+        std::cerr << "Failed to create journal in " << directory << std::endl;
+        if (catalog) std::fclose(catalog);
+        catalog = nullptr;
+        std::filesystem::remove(catalogPath, error);
+        if (first) std::filesystem::remove(std::filesystem::path(directory) / journalSegmentName(first->number), error);
+        return false;
+    }
+
+    current = first.get();
+    segments.push_back(first);
+    spare = second;
+    removeOldSegments();
+
+    opened = true;
+    commitThread = std::thread(&JournalWriter::runCommits, this);
+    return true;
+#endif
+}
+
+void JournalWriter::close() {
+    if (!opened) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (commitThread.joinable()) {
+        commitThread.join();
+    }
+    commitSegments();
+
+    // The spare was never written to; leave no empty segment behind
+    std::error_code error;
+    if (spare) std::filesystem::remove(std::filesystem::path(directory) / journalSegmentName(spare->number), error);
+    spare = nullptr;
+    segments.clear();
+    current = nullptr;
+
+    std::lock_guard<std::mutex> lock(catalogMutex);
+    std::fclose(catalog);
+    catalog = nullptr;
+    opened = false;
+}
+
+JournalWriter::SegmentPtr JournalWriter::createSegment(uint64_t number) {
+#ifdef _WIN32
+    (void)number;
+    return nullptr;
+#else
+    // Size the index for the whole file, then give what is left after it to records
+    size_t indexEntries = (segmentBytes / sizeof(JournalRecord) + JOURNAL_INDEX_STRIDE - 1) / JOURNAL_INDEX_STRIDE;
+    size_t recordsOffset = journalAlign(journalIndexOffset() + indexEntries * sizeof(int64_t), JOURNAL_PAGE_SIZE);
+    size_t capacity = (segmentBytes - recordsOffset) / sizeof(JournalRecord);
+
+    std::string path = (std::filesystem::path(directory) / journalSegmentName(number)).string();
+    int fd = ::open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return nullptr;
+
+    // Blocks are reserved up front: running out of disk while storing into a mapping is SIGBUS
+    bool sized = ftruncate(fd, (off_t)segmentBytes) == 0;
+#ifdef __linux__
+    sized = sized && posix_fallocate(fd, 0, (off_t)segmentBytes) == 0;
+#endif
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;  // Faulted in here, not by the appender
+#endif
+    void* memory = sized ? mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, flags, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        unlink(path.c_str());
+        return nullptr;
+    }
+
+    SegmentPtr segment = std::make_shared<Segment>();
+    segment->number = number;
+    segment->mapping = memory;
+    segment->size = segmentBytes;
+    segment->header = static_cast<JournalSegmentHeader*>(memory);
+    segment->index = reinterpret_cast<int64_t*>(static_cast<char*>(memory) + journalIndexOffset());
+    segment->records = reinterpret_cast<JournalRecord*>(static_cast<char*>(memory) + recordsOffset);
+
+    JournalSegmentHeader* header = segment->header;
+    header->version = JOURNAL_VERSION;
+    header->segment = number;
+    header->run = run;
+    header->capacity = (uint32_t)capacity;
+    header->indexEntries = (uint32_t)indexEntries;
+    header->recordsOffset = recordsOffset;
+    header->committed.store(0, std::memory_order_relaxed);
+    header->magic.store(JOURNAL_MAGIC, std::memory_order_release);
+    return segment;
+#endif
+}
+
+void JournalWriter::append(int64_t timestampNs, SensorId id, uint8_t oldState, uint8_t newState) {
+    if (!current) return;
+
+    uint32_t position = current->written.load(std::memory_order_relaxed);
+    if (position == current->header->capacity) {
+        if (!rotate()) {
+            Metrics::add(MetricCounter::JournalRecordsDropped);
+            return;
+        }
+        position = 0;
+    }
+
+    timestampNs = std::max(timestampNs, lastTimestampNs);
+    lastTimestampNs = timestampNs;
+    current->records[position] = {timestampNs, id, oldState, newState, 0};
+    if (position % JOURNAL_INDEX_STRIDE == 0) {
+        current->index[position / JOURNAL_INDEX_STRIDE] = timestampNs;
+    }
+    current->written.store(position + 1, std::memory_order_release);
+}
+
+// Switches to the segment the commit thread mapped ahead; never touches the disk itself
+bool JournalWriter::rotate() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!spare) return false;
+        current->sealed = true;
+        segments.push_back(spare);
+        current = spare.get();
+        spare = nullptr;
+    }
+    wake.notify_one();
+    return true;
+}
+
+void JournalWriter::recordSensor(SensorId id, std::string_view name, std::string_view location) {
+    std::lock_guard<std::mutex> lock(catalogMutex);
+    if (!catalog) return;
+
+    std::string entry;
+    auto appendLE = [&entry](uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            entry.push_back((char)((value >> (8 * i)) & 0xFF));
+        }
+    };
+    appendLE(id, 4);
+    appendLE(std::min<size_t>(name.size(), UINT16_MAX), 2);
+    entry.append(name.substr(0, UINT16_MAX));
+    appendLE(std::min<size_t>(location.size(), UINT16_MAX), 2);
+    entry.append(location.substr(0, UINT16_MAX));
+    std::fwrite(entry.data(), 1, entry.size(), catalog);
+    catalogDirty = true;
+}
+
+void JournalWriter::runCommits() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, commitInterval);
+        lock.unlock();
+        commitSegments();
+        prepareSpare();
+        lock.lock();
+    }
+}
+
+bool JournalWriter::commit() {
+    return opened && commitSegments();
+}
+
+bool JournalWriter::commitSegments() {
+#ifdef _WIN32
+    return false;
+#else
+    std::lock_guard<std::mutex> commitLock(commitMutex);
+    auto start = std::chrono::steady_clock::now();
+    bool ok = true;
+
+    // Names first, so every committed record can be resolved
+    {
+        std::lock_guard<std::mutex> lock(catalogMutex);
+        if (catalog && catalogDirty) {
+            ok = std::fflush(catalog) == 0 && fsync(fileno(catalog)) == 0;
+            catalogDirty = !ok;
+        }
+    }
+
+    std::vector<SegmentPtr> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = segments;
+    }
+
+    bool committedAny = false;
+    for (SegmentPtr& segment : pending) {
+        uint32_t written = segment->written.load(std::memory_order_acquire);
+        if (written == segment->synced) continue;
+
+        // The new records from the start of their first page, then the header and index
+        char* base = static_cast<char*>(segment->mapping);
+        size_t begin = segment->header->recordsOffset + segment->synced * sizeof(JournalRecord);
+        begin -= begin % JOURNAL_PAGE_SIZE;
+        size_t end = segment->header->recordsOffset + written * sizeof(JournalRecord);
+        bool synced = msync(base + begin, end - begin, MS_SYNC) == 0 &&
+                      msync(base, segment->header->recordsOffset, MS_SYNC) == 0;
+        if (!synced) {
+            ok = false;
+            continue;
+        }
+
+        // Only now may readers see them
+        segment->header->committed.store(written, std::memory_order_release);
+        if (msync(base, JOURNAL_PAGE_SIZE, MS_SYNC) != 0) ok = false;
+        Metrics::add(MetricCounter::JournalRecords, written - segment->synced);
+        segment->synced = written;
+        committedAny = true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        segments.erase(std::remove_if(segments.begin(), segments.end(), [](const SegmentPtr& segment) {
+            return segment->sealed && segment->synced == segment->written.load(std::memory_order_acquire);
+        }), segments.end());
+    }
+
+    if (committedAny) {
+        Metrics::record(MetricHistogram::JournalCommitNs, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    if (!ok) std::cerr << "Journal commit failed in " << directory << std::endl;
+    return ok;
+#endif
+}
+
+void JournalWriter::prepareSpare() {
+    uint64_t number;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (spare || stopping) return;
+        number = nextSegment++;
+    }
+
+    SegmentPtr segment = createSegment(number);
+    if (!segment) {
+        std::cerr << "Failed to create journal segment in " << directory << std::endl;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        spare = segment;
+    }
+    removeOldSegments();
+}
+
+void JournalWriter::removeOldSegments() {
+    std::error_code error;
+    std::vector<uint64_t> segmentNumbers;
+    std::vector<uint64_t> runs;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::string name = entry.path().filename().string();
+        uint64_t number;
+        if (journalParseFileName(name, "journal-", ".seg", number)) segmentNumbers.push_back(number);
+        if (journalParseFileName(name, "catalog-", ".bin", number)) runs.push_back(number);
+    }
+    if (segmentNumbers.size() <= maxSegments) return;
+
+    // Oldest first; the current and spare segments are always the newest
+    std::sort(segmentNumbers.begin(), segmentNumbers.end());
+    size_t excess = segmentNumbers.size() - maxSegments;
+    for (size_t i = 0; i < excess; ++i) {
+        std::filesystem::remove(std::filesystem::path(directory) / journalSegmentName(segmentNumbers[i]), error);
+    }
+
+    // A run's segments are numbered from the run on, so a catalog is still needed while any
+    // segment before the next run's remains
+    uint64_t oldestKept = segmentNumbers[excess];
+    std::sort(runs.begin(), runs.end());
+    for (size_t i = 0; i + 1 < runs.size(); ++i) {
+        if (runs[i + 1] <= oldestKept) {
+            std::filesystem::remove(std::filesystem::path(directory) / journalCatalogName(runs[i]), error);
+        }
+    }
+}
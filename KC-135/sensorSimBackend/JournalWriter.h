@@ -0,0 +1,95 @@
+#ifndef JOURNAL_WRITER_H
+#define JOURNAL_WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "Journal.h"
+#include "SensorRegistry.h"
+
+// Appends sensor state transitions to a memory-mapped, segment-rotated journal (Journal.h).
+//
+// append() only stores into the mapping: no syscall, no lock and no wait on the disk, so it
+// can sit on the broadcast path. A commit thread makes everything appended so far durable
+// every commitInterval with one msync per segment (group commit), then advances the
+// segment's committed count, which is all readers trust. It also maps the next segment
+// ahead of time and deletes the oldest beyond maxSegments. A crash loses at most the last
+// commit interval. One thread appends; recordSensor() may be called from any thread.
+// Unsupported on Windows.
+class JournalWriter {
+private:
+    struct Segment {
+        uint64_t number = 0;
+        void* mapping = nullptr;
+        size_t size = 0;
+        JournalSegmentHeader* header = nullptr;
+        int64_t* index = nullptr;
+        JournalRecord* records = nullptr;
+        std::atomic<uint32_t> written{0};  // Appended so far, published by the appender
+        uint32_t synced = 0;               // Committed so far; commit thread only
+        bool sealed = false;               // The appender has moved on; guarded by mutex
+
+        ~Segment();
+    };
+    typedef std::shared_ptr<Segment> SegmentPtr;
+
+    std::string directory;
+    size_t segmentBytes;
+    size_t maxSegments;
+    std::chrono::milliseconds commitInterval;
+    uint64_t run;
+    uint64_t nextSegment;
+    int64_t lastTimestampNs;
+
+    Segment* current;                  // Appender only
+    std::vector<SegmentPtr> segments;  // Not yet fully committed, oldest first; mutex
+    SegmentPtr spare;                  // Mapped ahead by the commit thread; mutex
+    std::mutex mutex;
+
+    std::FILE* catalog;
+    bool catalogDirty;
+    std::mutex catalogMutex;
+
+    std::mutex commitMutex;            // One commit at a time
+    std::thread commitThread;
+    std::condition_variable wake;
+    bool stopping;
+    std::atomic<bool> opened;
+
+    SegmentPtr createSegment(uint64_t number);
+    bool rotate();
+    void runCommits();
+    bool commitSegments();
+    void prepareSpare();
+    void removeOldSegments();
+
+public:
+    JournalWriter();
+    ~JournalWriter();
+
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    // Creates the directory if needed and starts a new run after any segments already there
+    bool open(const std::string& directory, size_t segmentBytes, size_t maxSegments,
+              std::chrono::milliseconds commitInterval);
+    // Commits what is left and unmaps everything
+    void close();
+    bool isOpen() const { return opened; }
+
+    // Timestamps earlier than the previous record's are raised to it so the index stays sorted
+    void append(int64_t timestampNs, SensorId id, uint8_t oldState, uint8_t newState);
+    void recordSensor(SensorId id, std::string_view name, std::string_view location);
+    // Blocks until everything appended so far is durable
+    bool commit();
+};
+
+#endif // JOURNAL_WRITER_H
@@ -0,0 +1,156 @@
+#include "Metrics.h"
+#include <atomic>
+#include <cstring>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+static const size_t COUNTER_COUNT = (size_t)MetricCounter::Count;
+static const size_t HISTOGRAM_COUNT = (size_t)MetricHistogram::Count;
+
+// More threads than this share shards, which stays correct because every add is atomic
+static const size_t MAX_SHARDS = 64;
+
+struct alignas(64) MetricShard {
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    std::atomic<uint64_t> buckets[HISTOGRAM_COUNT][Metrics::HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> sums[HISTOGRAM_COUNT];
+};
+
+// Static storage is zero-initialized before any thread can record
+static MetricShard shards[MAX_SHARDS];
+static std::atomic<size_t> nextShard(0);
+static thread_local MetricShard* threadShard = nullptr;
+
+static const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+    "clients_accepted",
+    "client_disconnects",
+    "frames_built",
+    "frames_dropped",
+    "bytes_sent",
+    "udp_datagrams_received",
+    "udp_datagrams_dropped",
+    "udp_datagrams_overflowed",
+    "frames_compressed",
+    "compression_input_bytes",
+    "compression_output_bytes",
+    "journal_records",
+    "journal_records_dropped",
+    "state_changes_coalesced",
+    "state_changes_suppressed",
+    "sensors_suppressed",
+    "udp_commands_applied",
+    "udp_state_updates_applied",
+    "udp_datagrams_malformed"
+};
+
+static const char* const HISTOGRAM_NAMES[HISTOGRAM_COUNT] = {
+    "send_latency_ns",
+    "client_queue_depth",
+    "snapshot_build_ns",
+    "compression_ns",
+    "journal_commit_ns",
+    "ingest_to_broadcast_ns",
+    "udp_socket_residency_ns",
+    "udp_queue_residency_ns"
+};
+
+static MetricShard& localShard() {
+    if (!threadShard) {
+        threadShard = &shards[nextShard.fetch_add(1, std::memory_order_relaxed) % MAX_SHARDS];
+    }
+    return *threadShard;
+}
+
+static size_t bucketFor(uint64_t value) {
+    if (value == 0) return 0;
+#ifdef _MSC_VER
+    unsigned long highest;
+    _BitScanReverse64(&highest, value);
+    return (size_t)highest + 1;
+#else
+    return 64 - (size_t)__builtin_clzll(value);
+#endif
+}
+
+void Metrics::add(MetricCounter counter, uint64_t amount) {
+    localShard().counters[(size_t)counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+void Metrics::record(MetricHistogram histogram, uint64_t value) {
+    MetricShard& shard = localShard();
+    shard.buckets[(size_t)histogram][bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sums[(size_t)histogram].fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Metrics::counter(MetricCounter counter) {
+    uint64_t total = 0;
+    for (const MetricShard& shard : shards) {
+        total += shard.counters[(size_t)counter].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Metrics::histogram(MetricHistogram histogram, HistogramTotals& totals) {
+    std::memset(&totals, 0, sizeof(totals));
+    for (const MetricShard& shard : shards) {
+        for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+            uint64_t count = shard.buckets[(size_t)histogram][b].load(std::memory_order_relaxed);
+            totals.buckets[b] += count;
+            totals.count += count;
+        }
+        totals.sum += shard.sums[(size_t)histogram].load(std::memory_order_relaxed);
+    }
+}
+
+std::string Metrics::renderText() {
+    std::string text;
+    for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+        std::string metric = std::string("sensor_") + COUNTER_NAMES[c] + "_total";
+        text += "# TYPE " + metric + " counter\n";
+        text += metric + " " + std::to_string(counter((MetricCounter)c)) + "\n";
+    }
+
+    HistogramTotals totals;
+    for (size_t h = 0; h < HISTOGRAM_COUNT; ++h) {
+        histogram((MetricHistogram)h, totals);
+        std::string metric = std::string("sensor_") + HISTOGRAM_NAMES[h];
+        text += "# TYPE " + metric + " histogram\n";
+
+        // Buckets are cumulative; the ones past the largest sample add nothing. The top
+        // bucket has no finite bound and is only covered by +Inf.
+        size_t last = 0;
+        for (size_t b = 0; b < HISTOGRAM_BUCKETS - 1; ++b) {
+            if (totals.buckets[b] > 0) last = b;
+        }
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b <= last; ++b) {
+            cumulative += totals.buckets[b];
+            uint64_t upper = ((uint64_t)1 << b) - 1;
+            text += metric + "_bucket{le=\"" + std::to_string(upper) + "\"} " + std::to_string(cumulative) + "\n";
+        }
+        text += metric + "_bucket{le=\"+Inf\"} " + std::to_string(totals.count) + "\n";
+        text += metric + "_sum " + std::to_string(totals.sum) + "\n";
+        text += metric + "_count " + std::to_string(totals.count) + "\n";
+    }
+    return text;
+}
+
+const char* Metrics::name(MetricCounter counter) {
+    return COUNTER_NAMES[(size_t)counter];
+}
+
+const char* Metrics::name(MetricHistogram histogram) {
+    return HISTOGRAM_NAMES[(size_t)histogram];
+}
+
+bool Metrics::findCounter(const char* name, MetricCounter& counter) {
+    for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+        if (std::strcmp(name, COUNTER_NAMES[c]) == 0) {
+            counter = (MetricCounter)c;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,73 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstdint>
+#include <string>
+
+enum class MetricCounter : uint8_t {
+    ClientsAccepted,
+    ClientDisconnects,
+    FramesBuilt,           // Encoded snapshots, deltas and dictionaries
+    FramesDropped,         // Discarded by the slow-consumer policy
+    BytesSent,
+    UdpDatagramsReceived,
+    UdpDatagramsDropped,
+    UdpDatagramsOverflowed,
+    FramesCompressed,       // Distinct frames deflated for compressing clients
+    CompressionInputBytes,
+    CompressionOutputBytes,
+    JournalRecords,         // Committed to disk
+    JournalRecordsDropped,  // No segment was ready to rotate into
+    StateChangesCoalesced,  // Transitions merged into a later broadcast of the same sensor
+    StateChangesSuppressed, // Transitions held back while their sensor was flap-damped
+    SensorsSuppressed,      // Times a sensor entered flap damping
+    UdpCommandsApplied,
+    UdpStateUpdatesApplied, // Sensor states set from UDP state update datagrams
+    UdpDatagramsMalformed,
+    Count
+};
+
+enum class MetricHistogram : uint8_t {
+    SendLatencyNs,         // Frame encoded until fully handed to a client's socket
+    QueueDepth,            // Client outbound queue length after each enqueue
+    SnapshotBuildNs,
+    CompressionNs,         // Deflating one frame
+    JournalCommitNs,       // One group commit of the state journal
+    IngestToBroadcastNs,   // UDP state update received until the delta carrying it is posted
+    UdpSocketResidencyNs,  // Datagram arrived at the socket until the receive thread read it
+    UdpQueueResidencyNs,   // Datagram queued in the listener's ring until a consumer took it
+    Count
+};
+
+// Process-wide counters and histograms for the sensor backend.
+//
+// Each thread records into its own cache-line-aligned shard with relaxed atomic adds, so a
+// sample costs a few nanoseconds, takes no lock and never bounces a cache line between
+// threads; it can stay enabled in production. Readers sum the shards. Histograms use
+// power-of-two buckets: bucket 0 counts zeros, bucket b values in [2^(b-1), 2^b).
+class Metrics {
+public:
+    static const size_t HISTOGRAM_BUCKETS = 65;
+
+    struct HistogramTotals {
+        uint64_t buckets[HISTOGRAM_BUCKETS];
+        uint64_t count;
+        uint64_t sum;
+    };
+
+    static void add(MetricCounter counter, uint64_t amount = 1);
+    static void record(MetricHistogram histogram, uint64_t value);
+
+    static uint64_t counter(MetricCounter counter);
+    static void histogram(MetricHistogram histogram, HistogramTotals& totals);
+
+    // Prometheus text exposition format
+    static std::string renderText();
+
+    static const char* name(MetricCounter counter);
+    static const char* name(MetricHistogram histogram);
+    // Looks a counter up by name(); false if there is none
+    static bool findCounter(const char* name, MetricCounter& counter);
+};
+
+#endif // METRICS_H
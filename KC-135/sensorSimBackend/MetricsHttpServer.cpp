@@ -0,0 +1,189 @@
+#include "MetricsHttpServer.h"
+#include "Metrics.h"
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #pragma comment(lib, "ws2_32.lib")
+#endif
+
+// Anything larger than this is not a scrape request
+static const size_t MAX_REQUEST_SIZE = 8192;
+static const std::chrono::seconds CLIENT_TIMEOUT(1);
+
+MetricsHttpServer::MetricsHttpServer(int port)
+    : port(port), listenSocket(INVALID_SOCKET_HANDLE), isRunning(false) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::cerr << "WSAStartup failed" << std::endl;
+    }
+#endif
+}
+
+MetricsHttpServer::~MetricsHttpServer() {
+    stop();
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+bool MetricsHttpServer::start() {
+    if (isRunning) return false;
+
+    listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket == INVALID_SOCKET_HANDLE) {
+        std::cerr << "Failed to create metrics socket" << std::endl;
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+
+    struct sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = INADDR_ANY;
+    serverAddr.sin_port = htons(port);
+
+    if (bind(listenSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0 ||
+        listen(listenSocket, 16) < 0) {
+        std::cerr << "Failed to listen for metrics on port " << port << std::endl;
+        closeListener();
+        return false;
+    }
+
+    if (!setSocketNonBlocking(listenSocket) || !reactor.open() || !reactor.add(listenSocket, Reactor::Readable)) {
+        std::cerr << "Failed to initialize metrics event loop" << std::endl;
+        closeListener();
+        return false;
+    }
+
+    isRunning = true;
+    thread = std::thread(&MetricsHttpServer::run, this);
+    std::cout << "Metrics endpoint listening on port " << port << std::endl;
+    return true;
+}
+
+void MetricsHttpServer::stop() {
+    if (!isRunning) return;
+
+    isRunning = false;
+    reactor.wakeup();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    closeListener();
+}
+
+void MetricsHttpServer::closeListener() {
+    if (listenSocket != INVALID_SOCKET_HANDLE) {
+        closeSocketHandle(listenSocket);
+        listenSocket = INVALID_SOCKET_HANDLE;
+    }
+    reactor.close();
+}
+
+void MetricsHttpServer::run() {
+    std::vector<Reactor::Event> ready;
+    while (isRunning) {
+        if (reactor.wait(ready, -1) < 0) {
+            std::cerr << "Metrics event loop wait failed" << std::endl;
+            break;
+        }
+        if (ready.empty()) continue;
+
+        // Drain the accept backlog; each request is short, so they are served in turn
+        while (isRunning) {
+            SocketHandle clientSocket = accept(listenSocket, nullptr, nullptr);
+            if (clientSocket == INVALID_SOCKET_HANDLE) {
+                if (socketInterrupted()) continue;
+                break;
+            }
+            serveClient(clientSocket);
+        }
+    }
+}
+
+// Waits until the client socket is ready for events; false on timeout or shutdown
+bool MetricsHttpServer::waitFor(SocketHandle clientSocket, uint32_t events,
+                                std::chrono::steady_clock::time_point deadline) {
+    if (!reactor.modify(clientSocket, events)) return false;
+
+    std::vector<Reactor::Event> ready;
+    while (isRunning) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) return false;
+        if (reactor.wait(ready, (int)remaining + 1) < 0) return false;
+        for (const Reactor::Event& event : ready) {
+            if (event.socket == clientSocket) return true;
+        }
+    }
+    return false;
+}
+
+void MetricsHttpServer::serveClient(SocketHandle clientSocket) {
+    if (!setSocketNonBlocking(clientSocket) || !reactor.add(clientSocket, Reactor::Readable)) {
+        closeSocketHandle(clientSocket);
+        return;
+    }
+    auto deadline = std::chrono::steady_clock::now() + CLIENT_TIMEOUT;
+
+    // Only the request line matters; headers are read to their end and ignored
+    std::string request;
+    char buffer[1024];
+    bool complete = false;
+    while (!complete && request.size() < MAX_REQUEST_SIZE) {
+        int bytesReceived = (int)recv(clientSocket, buffer, sizeof(buffer), 0);
+        if (bytesReceived > 0) {
+            request.append(buffer, (size_t)bytesReceived);
+            complete = request.find("\r\n\r\n") != std::string::npos || request.find("\n\n") != std::string::npos;
+            continue;
+        }
+        if (bytesReceived < 0 && socketInterrupted()) continue;
+        if (bytesReceived < 0 && socketWouldBlock() && waitFor(clientSocket, Reactor::Readable, deadline)) continue;
+        break;
+    }
+
+    if (complete) {
+        size_t lineEnd = request.find_first_of("\r\n");
+        std::string line = request.substr(0, lineEnd);
+        size_t methodEnd = line.find(' ');
+        size_t pathEnd = line.find(' ', methodEnd + 1);
+        std::string method = line.substr(0, methodEnd);
+        std::string path = methodEnd == std::string::npos ? "" : line.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+
+        std::string status = "200 OK";
+        std::string body;
+        if (method != "GET") {
+            status = "405 Method Not Allowed";
+        } else if (path == "/metrics" || path == "/") {
+            body = Metrics::renderText();
+        } else {
+            status = "404 Not Found";
+        }
+
+        std::string response = "HTTP/1.0 " + status + "\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size()) {
+            int bytesSent = (int)send(clientSocket, response.data() + sent, (int)(response.size() - sent), SEND_FLAGS);
+            if (bytesSent > 0) {
+                sent += (size_t)bytesSent;
+                continue;
+            }
+            if (bytesSent < 0 && socketInterrupted()) continue;
+            if (bytesSent < 0 && socketWouldBlock() && waitFor(clientSocket, Reactor::Writable, deadline)) continue;
+            break;
+        }
+    }
+
+    reactor.remove(clientSocket);
+    closeSocketHandle(clientSocket);
+}
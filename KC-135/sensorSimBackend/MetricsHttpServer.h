@@ -0,0 +1,41 @@
+#ifndef METRICS_HTTP_SERVER_H
+#define METRICS_HTTP_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "Reactor.h"
+#include "SocketCompat.h"
+
+// Plain-text HTTP endpoint serving Metrics::renderText() to scrapers, e.g.
+//   curl http://localhost:9180/metrics
+//
+// Runs on its own port and thread, apart from the status stream. Requests are answered one at
+// a time and the connection is closed after each; a client that has not finished within a
+// second is dropped so it cannot hold up the next scrape.
+class MetricsHttpServer {
+private:
+    int port;
+    SocketHandle listenSocket;
+    Reactor reactor;
+    std::thread thread;
+    std::atomic<bool> isRunning;
+
+    void run();
+    void serveClient(SocketHandle clientSocket);
+    bool waitFor(SocketHandle clientSocket, uint32_t events, std::chrono::steady_clock::time_point deadline);
+    void closeListener();
+
+public:
+    MetricsHttpServer(int port);
+    ~MetricsHttpServer();
+
+    MetricsHttpServer(const MetricsHttpServer&) = delete;
+    MetricsHttpServer& operator=(const MetricsHttpServer&) = delete;
+
+    bool start();
+    void stop();
+    bool running() const { return isRunning; }
+};
+
+#endif // METRICS_HTTP_SERVER_H
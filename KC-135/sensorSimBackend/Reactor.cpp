@@ -0,0 +1,274 @@
+#include "Reactor.h"
+#include <algorithm>
+
+#ifdef __linux__
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <sys/timerfd.h>
+#elif !defined(_WIN32)
+    #include <poll.h>
+#endif
+
+#ifdef _WIN32
+    // Without a wakeup handle the poll loop re-checks its state at this interval
+    static const int MAX_POLL_TIMEOUT_MS = 10;
+#endif
+
+Reactor::Reactor() : hasDeadline(false) {
+#ifdef __linux__
+    epollFd = -1;
+    wakeupFd = -1;
+    timerFd = -1;
+#elif !defined(_WIN32)
+    wakeupPipe[0] = -1;
+    wakeupPipe[1] = -1;
+#endif
+}
+
+Reactor::~Reactor() {
+    close();
+}
+
+bool Reactor::open() {
+#ifdef __linux__
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) return false;
+
+    wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeupFd < 0) {
+        close();
+        return false;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeupFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeupFd, &ev) < 0) {
+        close();
+        return false;
+    }
+
+    // steady_clock is CLOCK_MONOTONIC on Linux, so deadlines can be armed as absolute times
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    ev.data.fd = timerFd;
+    if (timerFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev) < 0) {
+        close();
+        return false;
+    }
+    hasDeadline = false;
+    return true;
+#elif defined(_WIN32)
+    registrations.clear();
+    return true;
+#else
+    if (pipe(wakeupPipe) < 0) return false;
+    setSocketNonBlocking(wakeupPipe[0]);
+    setSocketNonBlocking(wakeupPipe[1]);
+    registrations.clear();
+    return true;
+#endif
+}
+
+void Reactor::close() {
+    hasDeadline = false;
+#ifdef __linux__
+    if (timerFd >= 0) {
+        ::close(timerFd);
+        timerFd = -1;
+    }
+    if (wakeupFd >= 0) {
+        ::close(wakeupFd);
+        wakeupFd = -1;
+    }
+    if (epollFd >= 0) {
+        ::close(epollFd);
+        epollFd = -1;
+    }
+#else
+    registrations.clear();
+#ifndef _WIN32
+    for (int& fd : wakeupPipe) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+#endif
+#endif
+}
+
+#ifdef __linux__
+static uint32_t toEpollEvents(uint32_t events) {
+    uint32_t result = 0;
+    if (events & Reactor::Readable) result |= EPOLLIN;
+    if (events & Reactor::Writable) result |= EPOLLOUT;
+    return result | EPOLLRDHUP;
+}
+#endif
+
+bool Reactor::add(SocketHandle socket, uint32_t events) {
+#ifdef __linux__
+    struct epoll_event ev = {};
+    ev.events = toEpollEvents(events);
+    ev.data.fd = socket;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, socket, &ev) == 0;
+#else
+    registrations.push_back({socket, events});
+    return true;
+#endif
+}
+
+bool Reactor::modify(SocketHandle socket, uint32_t events) {
+#ifdef __linux__
+    struct epoll_event ev = {};
+    ev.events = toEpollEvents(events);
+    ev.data.fd = socket;
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, socket, &ev) == 0;
+#else
+    for (Event& registration : registrations) {
+        if (registration.socket == socket) {
+            registration.events = events;
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+void Reactor::remove(SocketHandle socket) {
+#ifdef __linux__
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, socket, nullptr);
+#else
+    registrations.erase(std::remove_if(registrations.begin(), registrations.end(),
+                                       [socket](const Event& e) { return e.socket == socket; }),
+                        registrations.end());
+#endif
+}
+
+int Reactor::wait(std::vector<Event>& ready, int timeoutMs) {
+    ready.clear();
+
+#ifdef __linux__
+    struct epoll_event events[64];
+    int count = epoll_wait(epollFd, events, 64, timeoutMs);
+    if (count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (events[i].data.fd == wakeupFd || events[i].data.fd == timerFd) {
+            uint64_t value;
+            while (read(events[i].data.fd, &value, sizeof(value)) > 0) {
+            }
+            continue;
+        }
+
+        uint32_t mask = 0;
+        if (events[i].events & EPOLLIN) mask |= Readable;
+        if (events[i].events & EPOLLOUT) mask |= Writable;
+        if (events[i].events & (EPOLLHUP | EPOLLRDHUP)) mask |= Closed;
+        if (events[i].events & EPOLLERR) mask |= Error;
+        ready.push_back({events[i].data.fd, mask});
+    }
+    return (int)ready.size();
+#else
+    if (hasDeadline) {
+        // Round up so the loop never wakes just before the deadline
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        long long deadlineMs = std::max<long long>(0,
+            std::chrono::duration_cast<std::chrono::milliseconds>(remaining + std::chrono::microseconds(999)).count());
+        if (timeoutMs < 0 || deadlineMs < timeoutMs) {
+            timeoutMs = (int)std::min<long long>(deadlineMs, 1 << 30);
+        }
+    }
+#ifdef _WIN32
+    std::vector<WSAPOLLFD> fds;
+    if (timeoutMs < 0 || timeoutMs > MAX_POLL_TIMEOUT_MS) {
+        timeoutMs = MAX_POLL_TIMEOUT_MS;
+    }
+#else
+    std::vector<struct pollfd> fds;
+    fds.push_back({wakeupPipe[0], POLLIN, 0});
+#endif
+    for (const Event& registration : registrations) {
+        short pollEvents = 0;
+        if (registration.events & Readable) pollEvents |= POLLIN;
+        if (registration.events & Writable) pollEvents |= POLLOUT;
+        fds.push_back({registration.socket, pollEvents, 0});
+    }
+
+#ifdef _WIN32
+    if (fds.empty()) {
+        Sleep(timeoutMs);
+        return 0;
+    }
+    int count = WSAPoll(fds.data(), (ULONG)fds.size(), timeoutMs);
+#else
+    int count = poll(fds.data(), fds.size(), timeoutMs);
+#endif
+    if (count < 0) {
+        return socketInterrupted() ? 0 : -1;
+    }
+
+    for (const auto& fd : fds) {
+        if (fd.revents == 0) continue;
+#ifndef _WIN32
+        if (fd.fd == wakeupPipe[0]) {
+            char drain[64];
+            while (read(wakeupPipe[0], drain, sizeof(drain)) > 0) {
+            }
+            continue;
+        }
+#endif
+        uint32_t mask = 0;
+        if (fd.revents & POLLIN) mask |= Readable;
+        if (fd.revents & POLLOUT) mask |= Writable;
+        if (fd.revents & (POLLHUP | POLLNVAL)) mask |= Closed;
+        if (fd.revents & POLLERR) mask |= Error;
+        ready.push_back({fd.fd, mask});
+    }
+    return (int)ready.size();
+#endif
+}
+
+void Reactor::wakeup() {
+#ifdef __linux__
+    if (wakeupFd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeupFd, &one, sizeof(one));
+        (void)ignored;
+    }
+#elif !defined(_WIN32)
+    if (wakeupPipe[1] >= 0) {
+        char one = 1;
+        ssize_t ignored = write(wakeupPipe[1], &one, 1);
+        (void)ignored;
+    }
+#endif
+}
+
+void Reactor::setDeadline(std::chrono::steady_clock::time_point when) {
+    if (hasDeadline && when == deadline) return;
+    deadline = when;
+    hasDeadline = true;
+
+#ifdef __linux__
+    auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count();
+    struct itimerspec spec = {};
+    // A zero it_value would disarm the timer; anything in the past fires immediately
+    sinceEpoch = std::max<long long>(sinceEpoch, 1);
+    spec.it_value.tv_sec = (time_t)(sinceEpoch / 1000000000LL);
+    spec.it_value.tv_nsec = (long)(sinceEpoch % 1000000000LL);
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+#endif
+}
+
+void Reactor::clearDeadline() {
+    if (!hasDeadline) return;
+    hasDeadline = false;
+
+#ifdef __linux__
+    struct itimerspec spec = {};
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+#endif
+}
@@ -0,0 +1,66 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "SocketCompat.h"
+
+// Readiness notification for a set of sockets.
+// Uses epoll on Linux and falls back to poll()/WSAPoll() elsewhere.
+class Reactor {
+public:
+    enum EventMask : uint32_t {
+        Readable = 1u << 0,
+        Writable = 1u << 1,
+        Closed   = 1u << 2,  // Peer hung up
+        Error    = 1u << 3   // Pending socket error or error-queue notification
+    };
+
+    struct Event {
+        SocketHandle socket;
+        uint32_t events;
+    };
+
+private:
+    std::chrono::steady_clock::time_point deadline;
+    bool hasDeadline;
+#ifdef __linux__
+    int epollFd;
+    int wakeupFd;
+    int timerFd;
+#else
+    std::vector<Event> registrations;
+#ifndef _WIN32
+    int wakeupPipe[2];
+#endif
+#endif
+
+public:
+    Reactor();
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    bool open();
+    void close();
+
+    bool add(SocketHandle socket, uint32_t events);
+    bool modify(SocketHandle socket, uint32_t events);
+    void remove(SocketHandle socket);
+
+    // Blocks for at most timeoutMs (-1 = forever) and fills ready with the sockets that fired.
+    // Returns the number of events, 0 on timeout or wakeup, -1 on error.
+    int wait(std::vector<Event>& ready, int timeoutMs);
+
+    // Makes a concurrent or subsequent wait() return immediately. Safe from any thread.
+    void wakeup();
+
+    // Makes wait() return no later than the given absolute time. Backed by a timerfd on Linux
+    // so sub-millisecond deadlines are honoured; elsewhere it bounds the poll timeout.
+    void setDeadline(std::chrono::steady_clock::time_point when);
+    void clearDeadline();
+};
+
+#endif // REACTOR_H
@@ -0,0 +1,66 @@
+#include "ReplayBuffer.h"
+#include <algorithm>
+
+ReplayBuffer::ReplayBuffer(size_t capacity)
+    : capacity(capacity), next(0), lastSequence(0), evictedSequence(0) {
+}
+
+void ReplayBuffer::setCapacity(size_t broadcasts) {
+    entries.clear();
+    capacity = broadcasts;
+    next = 0;
+    evictedSequence = lastSequence;
+}
+
+void ReplayBuffer::record(uint64_t sequence, const std::vector<SensorId>& ids, const uint8_t* previous) {
+    lastSequence = sequence;
+    if (capacity == 0) {
+        evictedSequence = sequence;
+        return;
+    }
+
+    if (entries.size() < capacity) {
+        entries.push_back(Entry());
+    } else {
+        evictedSequence = entries[next].sequence;
+    }
+    // Overwriting reuses the evicted entry's buffers
+    Entry& entry = entries[next];
+    entry.sequence = sequence;
+    entry.ids.assign(ids.begin(), ids.end());
+    entry.previous.assign(previous, previous + ids.size());
+    next = (next + 1) % capacity;
+}
+
+bool ReplayBuffer::collect(uint64_t sequence, uint64_t currentSequence,
+                           std::vector<SensorId>& ids, std::vector<uint8_t>& previous) const {
+    ids.clear();
+    previous.clear();
+    if (capacity == 0 || sequence < evictedSequence || sequence > currentSequence) return false;
+
+    struct Change {
+        SensorId id;
+        uint64_t sequence;
+        uint8_t previous;
+    };
+    std::vector<Change> changes;
+    size_t start = entries.size() < capacity ? 0 : next;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Entry& entry = entries[(start + i) % entries.size()];
+        if (entry.sequence <= sequence) continue;
+        for (size_t j = 0; j < entry.ids.size(); ++j) {
+            changes.push_back({entry.ids[j], entry.sequence, entry.previous[j]});
+        }
+    }
+
+    // The earliest change after sequence holds the state the client last saw
+    std::sort(changes.begin(), changes.end(), [](const Change& a, const Change& b) {
+        return a.id != b.id ? a.id < b.id : a.sequence < b.sequence;
+    });
+    for (size_t i = 0; i < changes.size(); ++i) {
+        if (i > 0 && changes[i].id == changes[i - 1].id) continue;
+        ids.push_back(changes[i].id);
+        previous.push_back(changes[i].previous);
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef REPLAY_BUFFER_H
+#define REPLAY_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+#include "SensorRegistry.h"
+
+// Bounded history of the most recent broadcasts, so a reconnecting client can be sent just
+// what it missed instead of a full snapshot.
+//
+// Each entry records which sensors a broadcast changed and the state each had before it.
+// States themselves are not stored: a resume delta carries current states, and the previous
+// ones only tell whether the client could see a sensor through its state filter. The oldest
+// entry is overwritten once the buffer is full. Not thread-safe; the server's encoder
+// lock covers it.
+class ReplayBuffer {
+private:
+    struct Entry {
+        uint64_t sequence;
+        std::vector<SensorId> ids;
+        std::vector<uint8_t> previous;  // State of ids[i] before this broadcast
+    };
+
+    std::vector<Entry> entries;
+    size_t capacity;
+    size_t next;                // Slot the next entry is written to
+    uint64_t lastSequence;
+    uint64_t evictedSequence;   // Resuming from before this is no longer possible
+
+public:
+    explicit ReplayBuffer(size_t capacity = 1024);
+
+    // Drops the history; capacity 0 disables replay
+    void setCapacity(size_t broadcasts);
+
+    // sequence must increase from call to call
+    void record(uint64_t sequence, const std::vector<SensorId>& ids, const uint8_t* previous);
+
+    // Sensors changed by broadcasts after sequence, each once and sorted by ID, with the state
+    // it had as of sequence. Returns false if that history has already been overwritten or
+    // sequence is newer than anything recorded.
+    bool collect(uint64_t sequence, uint64_t currentSequence,
+                 std::vector<SensorId>& ids, std::vector<uint8_t>& previous) const;
+};
+
+#endif // REPLAY_BUFFER_H
@@ -2,15 +2,25 @@
 #include "SensorControllerAPI.h"
 #include "TCPServer.h"
 #include "Sensor.h"
+#include "Metrics.h"
+#include "MetricsHttpServer.h"
+#include <algorithm>
 #include <thread>
 #include <memory>
 #include <atomic>
 #include <chrono>
+#include <cstring>
+#include <mutex>
 #include <random>
+#include <shared_mutex>
 
 static std::unique_ptr<TCPServer> tcpServer = nullptr;
+// Held shared by the sensor exports so StopSensorController cannot free the server under them
+static std::shared_mutex tcpServerMutex;
 static std::thread serverThread;
 static std::atomic<bool> running = false;
+static std::unique_ptr<MetricsHttpServer> metricsServer = nullptr;
+static std::mutex metricsServerMutex;
 
 void ServerThreadFunction() {
     if (!tcpServer) return;
@@ -22,10 +32,12 @@ void ServerThreadFunction() {
     Sensor sensorD("Sensor 4", "Tail");
     
     // Add sensors to the server
-    tcpServer->addSensor(sensorA);
-    tcpServer->addSensor(sensorB);
-    tcpServer->addSensor(sensorC);
-    tcpServer->addSensor(sensorD);
+    SensorId sensorIds[] = {
+        tcpServer->addSensor(sensorA),
+        tcpServer->addSensor(sensorB),
+        tcpServer->addSensor(sensorC),
+        tcpServer->addSensor(sensorD)
+    };
     
     // Start the TCP server
     if (!tcpServer->startServer()) {
@@ -37,6 +49,7 @@ void ServerThreadFunction() {
     std::random_device rd;
     std::mt19937 gen(rd());
     std::uniform_int_distribution<> stateDist(0, 4);
+    std::uniform_int_distribution<size_t> sensorDist(0, 3);
     
     int counter = 0;
     while (running) {
@@ -44,8 +57,8 @@ void ServerThreadFunction() {
         
         // Occasionally change a random sensor state for demonstration
         if (counter % 5 == 0) {
-            // SensorState newState = static_cast<SensorState>(stateDist(gen));
-            // Simulate sensor state changes...
+            SensorState newState = static_cast<SensorState>(stateDist(gen));
+            tcpServer->setSensorState(sensorIds[sensorDist(gen)], newState);
         }
         
         counter++;
@@ -58,7 +71,10 @@ extern "C" {
             return false; // Already running
         }
         
-        tcpServer = std::make_unique<TCPServer>(8080);
+        {
+            std::unique_lock<std::shared_mutex> lock(tcpServerMutex);
+            tcpServer = std::make_unique<TCPServer>(8080);
+        }
         running = true;
         
         serverThread = std::thread(ServerThreadFunction);
@@ -77,6 +93,7 @@ extern "C" {
             serverThread.join();
         }
         
+        std::unique_lock<std::shared_mutex> lock(tcpServerMutex);
         tcpServer.reset();
         
         return true;
@@ -85,4 +102,67 @@ extern "C" {
     SENSOR_API bool IsRunning() {
         return running;
     }
-}
\ No newline at end of file
+
+    SENSOR_API uint32_t GetSensorCount() {
+        std::shared_lock<std::shared_mutex> lock(tcpServerMutex);
+        return tcpServer ? (uint32_t)tcpServer->getSensorCount() : 0;
+    }
+
+    SENSOR_API uint32_t FindSensorId(const char* name) {
+        std::shared_lock<std::shared_mutex> lock(tcpServerMutex);
+        if (!tcpServer || !name) return INVALID_SENSOR_ID;
+        return tcpServer->findSensor(name);
+    }
+
+    SENSOR_API bool SetSensorState(uint32_t sensorId, uint8_t state) {
+        std::shared_lock<std::shared_mutex> lock(tcpServerMutex);
+        if (!tcpServer) return false;
+        return tcpServer->setSensorState(sensorId, (SensorState)state);
+    }
+
+    SENSOR_API size_t SetSensorStates(const uint32_t* sensorIds, const uint8_t* states, size_t n) {
+        std::shared_lock<std::shared_mutex> lock(tcpServerMutex);
+        if (!tcpServer || !sensorIds || !states) return 0;
+        return tcpServer->setSensorStates(sensorIds, states, n);
+    }
+
+    SENSOR_API size_t GetSensorSnapshot(uint8_t* out, size_t capacity, uint64_t* generation) {
+        std::shared_lock<std::shared_mutex> lock(tcpServerMutex);
+        uint64_t snapshotGeneration = 0;
+        size_t total = 0;
+        if (tcpServer) {
+            total = tcpServer->copySensorStates(out, out ? capacity : 0, snapshotGeneration);
+        }
+        if (generation) *generation = snapshotGeneration;
+        return total;
+    }
+
+    SENSOR_API size_t GetMetricsText(char* out, size_t capacity) {
+        std::string text = Metrics::renderText();
+        if (out && capacity > 0) {
+            size_t copied = std::min(text.size(), capacity - 1);
+            memcpy(out, text.data(), copied);
+            out[copied] = '\0';
+        }
+        return text.size();
+    }
+
+    SENSOR_API uint64_t GetMetricCounter(const char* name) {
+        MetricCounter counter;
+        if (!name || !Metrics::findCounter(name, counter)) return 0;
+        return Metrics::counter(counter);
+    }
+
+    SENSOR_API bool EnableMetricsEndpoint(uint16_t port) {
+        std::lock_guard<std::mutex> lock(metricsServerMutex);
+        metricsServer.reset();
+        if (port == 0) return true;
+
+        metricsServer = std::make_unique<MetricsHttpServer>(port);
+        if (!metricsServer->start()) {
+            metricsServer.reset();
+            return false;
+        }
+        return true;
+    }
+}
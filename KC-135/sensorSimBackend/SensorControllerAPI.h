@@ -1,6 +1,9 @@
 #ifndef SENSOR_CONTROLLER_API_H
 #define SENSOR_CONTROLLER_API_H
 
+#include <cstddef>
+#include <cstdint>
+
 #ifdef _WIN32
     #ifdef SENSOR_CONTROLLER_EXPORTS
         #define SENSOR_API __declspec(dllexport)
@@ -15,6 +18,33 @@ extern "C" {
     SENSOR_API bool StartSensorController();
     SENSOR_API bool StopSensorController();
     SENSOR_API bool IsRunning();
+
+    // Sensor IDs are dense, starting at 0, in the order sensors were added.
+    // These may be called from any thread while the controller is running.
+    SENSOR_API uint32_t GetSensorCount();
+    // Returns UINT32_MAX if no sensor has this name
+    SENSOR_API uint32_t FindSensorId(const char* name);
+    // state is a SensorState value (0 = Off ... 4 = Degraded); the change is pushed to clients
+    SENSOR_API bool SetSensorState(uint32_t sensorId, uint8_t state);
+
+    // Batch entry points for in-process callers: one call per frame, plain arrays, no strings.
+    // Applies n updates atomically with respect to snapshots; unknown IDs and invalid states
+    // are skipped. Returns the number applied.
+    SENSOR_API size_t SetSensorStates(const uint32_t* sensorIds, const uint8_t* states, size_t n);
+    // Copies up to capacity states into out, indexed by sensor ID, as one consistent snapshot.
+    // generation (optional) receives a counter that changes whenever any state changes, so a
+    // caller can skip redrawing an unchanged frame. Returns the total sensor count; when it
+    // exceeds capacity only the first capacity states were copied.
+    SENSOR_API size_t GetSensorSnapshot(uint8_t* out, size_t capacity, uint64_t* generation);
+
+    // Runtime metrics; these work whether or not the controller is running.
+    // Writes the metrics in Prometheus text format into out, NUL-terminated and truncated to
+    // fit. Returns the full text length, so a caller can retry with a larger buffer.
+    SENSOR_API size_t GetMetricsText(char* out, size_t capacity);
+    // Current value of a counter by name, e.g. "bytes_sent"; 0 for an unknown name
+    SENSOR_API uint64_t GetMetricCounter(const char* name);
+    // Serves the metrics over HTTP on this port; 0 stops the endpoint
+    SENSOR_API bool EnableMetricsEndpoint(uint16_t port);
 }
 
 #endif // SENSOR_CONTROLLER_API_H
\ No newline at end of file
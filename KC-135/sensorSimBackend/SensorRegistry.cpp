@@ -0,0 +1,64 @@
+#include "SensorRegistry.h"
+#include <functional>
+
+SensorRegistry::SensorRegistry()
+    : nameOffsets(1, 0), nameIndex(16, INVALID_SENSOR_ID) {
+}
+
+uint32_t SensorRegistry::internLocation(const std::string& location) {
+    auto it = locationIds.find(std::string_view(location));
+    if (it != locationIds.end()) return it->second;
+
+    uint32_t id = (uint32_t)locationPool.size();
+    locationPool.push_back(location);
+    locationIds.emplace(std::string_view(locationPool.back()), id);
+    return id;
+}
+
+SensorId SensorRegistry::add(const std::string& name, const std::string& location, SensorState state) {
+    SensorId existing = find(name);
+    if (existing != INVALID_SENSOR_ID) return existing;
+
+    SensorId id = (SensorId)states.size();
+    nameArena.append(name);
+    nameOffsets.push_back((uint32_t)nameArena.size());
+    sensorLocations.push_back(internLocation(location));
+    states.push_back((uint8_t)state);
+
+    // Keep the index at most half full so probe sequences stay short
+    if ((states.size() * 2) > nameIndex.size()) {
+        growIndex();
+    } else {
+        insertIntoIndex(id);
+    }
+    return id;
+}
+
+SensorId SensorRegistry::add(const Sensor& sensor) {
+    return add(sensor.getName(), sensor.getLocation(), sensor.getCurrentState());
+}
+
+SensorId SensorRegistry::find(std::string_view name) const {
+    size_t mask = nameIndex.size() - 1;
+    for (size_t slot = std::hash<std::string_view>()(name) & mask;; slot = (slot + 1) & mask) {
+        SensorId id = nameIndex[slot];
+        if (id == INVALID_SENSOR_ID) return INVALID_SENSOR_ID;
+        if (getName(id) == name) return id;
+    }
+}
+
+void SensorRegistry::insertIntoIndex(SensorId id) {
+    size_t mask = nameIndex.size() - 1;
+    size_t slot = std::hash<std::string_view>()(getName(id)) & mask;
+    while (nameIndex[slot] != INVALID_SENSOR_ID) {
+        slot = (slot + 1) & mask;
+    }
+    nameIndex[slot] = id;
+}
+
+void SensorRegistry::growIndex() {
+    nameIndex.assign(nameIndex.size() * 2, INVALID_SENSOR_ID);
+    for (SensorId id = 0; id < states.size(); ++id) {
+        insertIntoIndex(id);
+    }
+}
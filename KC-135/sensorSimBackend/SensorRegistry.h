@@ -0,0 +1,61 @@
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Sensor.h"
+#include "SensorState.h"
+
+typedef uint32_t SensorId;
+static const SensorId INVALID_SENSOR_ID = UINT32_MAX;
+
+// Struct-of-arrays sensor table.
+//
+// Sensors get dense, stable IDs in the order they are added and are never removed.
+// Names are packed back to back in one character arena and indexed by an open-addressing
+// table of IDs, giving O(1) lookup for a few bytes per sensor. Locations are interned, so
+// one shared by thousands of sensors is stored once. States live in one contiguous byte
+// array that snapshot encoders and change detection scan linearly.
+class SensorRegistry {
+private:
+    std::string nameArena;
+    std::vector<uint32_t> nameOffsets;   // size() + 1 entries; name i is [offsets[i], offsets[i+1])
+    std::vector<SensorId> nameIndex;     // Power-of-two hash table, INVALID_SENSOR_ID = empty
+
+    std::deque<std::string> locationPool;  // deque keeps the views below valid as it grows
+    std::unordered_map<std::string_view, uint32_t> locationIds;
+    std::vector<uint32_t> sensorLocations;
+
+    std::vector<uint8_t> states;
+
+    uint32_t internLocation(const std::string& location);
+    void insertIntoIndex(SensorId id);
+    void growIndex();
+
+public:
+    SensorRegistry();
+
+    // Returns the new ID, or the existing ID if a sensor with this name was already added
+    SensorId add(const std::string& name, const std::string& location, SensorState state);
+    SensorId add(const Sensor& sensor);
+
+    SensorId find(std::string_view name) const;
+    size_t size() const { return states.size(); }
+
+    std::string_view getName(SensorId id) const {
+        return std::string_view(nameArena).substr(nameOffsets[id], nameOffsets[id + 1] - nameOffsets[id]);
+    }
+    const std::string& getLocation(SensorId id) const { return locationPool[sensorLocations[id]]; }
+    SensorState getState(SensorId id) const { return (SensorState)states[id]; }
+    void setState(SensorId id, SensorState state) { states[id] = (uint8_t)state; }
+
+    // One byte per sensor, indexed by ID
+    const uint8_t* stateData() const { return states.data(); }
+    uint8_t* stateData() { return states.data(); }
+};
+
+#endif // SENSOR_REGISTRY_H
@@ -1,6 +1,8 @@
 #ifndef SENSOR_STATE_H
 #define SENSOR_STATE_H
 
+#include <cstdint>
+
 enum class SensorState {
     Off,
     Initializing,
@@ -9,4 +11,19 @@ enum class SensorState {
     Degraded
 };
 
-#endif // SENSOR_STATE_H
\ No newline at end of file
+inline bool isValidSensorState(uint8_t value) {
+    return value <= (uint8_t)SensorState::Degraded;
+}
+
+inline const char* sensorStateName(SensorState state) {
+    switch (state) {
+        case SensorState::Off: return "Off";
+        case SensorState::Initializing: return "Initializing";
+        case SensorState::Operational: return "Operational";
+        case SensorState::Declaring: return "Declaring";
+        case SensorState::Degraded: return "Degraded";
+    }
+    return "Unknown";
+}
+
+#endif // SENSOR_STATE_H
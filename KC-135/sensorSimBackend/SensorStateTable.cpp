@@ -0,0 +1,95 @@
+#include "SensorStateTable.h"
+#include <thread>
+
+SensorStateTable::SensorStateTable()
+    : count(0), sequence(0) {
+}
+
+size_t SensorStateTable::append(SensorState state) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    size_t index = count.load(std::memory_order_relaxed);
+    if (index >= MAX_SENSORS) return MAX_SENSORS;
+
+    std::unique_ptr<std::atomic<uint8_t>[]>& chunk = chunks[index >> CHUNK_BITS];
+    if (!chunk) {
+        chunk.reset(new std::atomic<uint8_t>[CHUNK_SIZE]);
+    }
+    slot(index).store((uint8_t)state, std::memory_order_relaxed);
+
+    // A new sensor is a new snapshot too; the release on count publishes the chunk
+    sequence.fetch_add(2, std::memory_order_release);
+    count.store(index + 1, std::memory_order_release);
+    return index;
+}
+
+bool SensorStateTable::set(size_t index, SensorState state, SensorState& previous) {
+    if (index >= count.load(std::memory_order_acquire)) return false;
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::atomic<uint8_t>& target = slot(index);
+    previous = (SensorState)target.load(std::memory_order_relaxed);
+    if (previous == state) return true;
+
+    uint64_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    target.store((uint8_t)state, std::memory_order_relaxed);
+    sequence.store(seq + 2, std::memory_order_release);
+    return true;
+}
+
+size_t SensorStateTable::setMany(const uint32_t* indices, const uint8_t* states, size_t n,
+                                 std::vector<uint32_t>& changed) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    size_t limit = count.load(std::memory_order_relaxed);
+    uint64_t seq = sequence.load(std::memory_order_relaxed);
+    bool writing = false;
+    size_t applied = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        if (indices[i] >= limit || !isValidSensorState(states[i])) continue;
+        applied++;
+
+        std::atomic<uint8_t>& target = slot(indices[i]);
+        if (target.load(std::memory_order_relaxed) == states[i]) continue;
+
+        // The sequence only goes odd once something really changes
+        if (!writing) {
+            sequence.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            writing = true;
+        }
+        target.store(states[i], std::memory_order_relaxed);
+        changed.push_back(indices[i]);
+    }
+
+    if (writing) sequence.store(seq + 2, std::memory_order_release);
+    return applied;
+}
+
+void SensorStateTable::copyTo(uint8_t* out, size_t n) const {
+    for (size_t base = 0; base < n; base += CHUNK_SIZE) {
+        const std::atomic<uint8_t>* chunk = chunks[base >> CHUNK_BITS].get();
+        size_t end = n - base < CHUNK_SIZE ? n - base : CHUNK_SIZE;
+        for (size_t i = 0; i < end; ++i) {
+            out[base + i] = chunk[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t SensorStateTable::read(uint8_t* out, size_t n) const {
+    if (n > size()) n = size();
+
+    for (;;) {
+        uint64_t before = sequence.load(std::memory_order_acquire);
+        // A writer is mid-update; copying now would only be thrown away
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        copyTo(out, n);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before) return before / 2;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef SENSOR_STATE_TABLE_H
+#define SENSOR_STATE_TABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "SensorState.h"
+
+// Live sensor states shared between producer threads and the broadcast thread.
+//
+// Each state is one atomic byte in fixed-size chunks that never move, so the table can grow
+// while others read it. A sequence counter turns the table into a seqlock: writers make it
+// odd for the duration of a change, and a reader copying the whole table retries if the
+// counter moved underneath it. Writers are serialized among themselves only; readers never
+// hold a lock a writer could wait on.
+class SensorStateTable {
+private:
+    static const size_t CHUNK_BITS = 16;
+    static const size_t CHUNK_SIZE = (size_t)1 << CHUNK_BITS;
+    static const size_t MAX_CHUNKS = 256;
+
+    std::unique_ptr<std::atomic<uint8_t>[]> chunks[MAX_CHUNKS];
+    std::atomic<size_t> count;
+    std::atomic<uint64_t> sequence;  // Odd while a write is in progress; generation is sequence / 2
+    std::mutex writeMutex;
+
+    std::atomic<uint8_t>& slot(size_t index) const {
+        return chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)];
+    }
+    void copyTo(uint8_t* out, size_t n) const;
+
+public:
+    static constexpr size_t MAX_SENSORS = CHUNK_SIZE * MAX_CHUNKS;
+
+    SensorStateTable();
+
+    // Appends a sensor and returns its index, or MAX_SENSORS when the table is full
+    size_t append(SensorState state);
+
+    // Returns false for an index that was never appended. previous receives the state that
+    // was replaced; an unchanged state does not advance the generation.
+    bool set(size_t index, SensorState state, SensorState& previous);
+
+    // Applies n updates as one write, so a reader sees all of them or none. Unknown indices
+    // and invalid states are skipped. Returns the number applied; indices whose state
+    // actually changed are appended to changed.
+    size_t setMany(const uint32_t* indices, const uint8_t* states, size_t n, std::vector<uint32_t>& changed);
+
+    SensorState get(size_t index) const { return (SensorState)slot(index).load(std::memory_order_relaxed); }
+    size_t size() const { return count.load(std::memory_order_acquire); }
+    uint64_t generation() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+    // Copies the first n states as one consistent snapshot and returns its generation.
+    // Retries until no write overlapped the copy, yielding while one is in progress; a write
+    // is a handful of stores, so only updates arriving back to back faster than a full copy
+    // could keep a reader waiting.
+    uint64_t read(uint8_t* out, size_t n) const;
+};
+
+#endif // SENSOR_STATE_TABLE_H
@@ -0,0 +1,55 @@
+#ifndef SHARED_SNAPSHOT_H
+#define SHARED_SNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the shared-memory segment the controller publishes sensor snapshots into.
+//
+//   [SharedSnapshotHeader][slot 0][slot 1]...[slot slotCount - 1]
+//
+// Each slot is a SharedSnapshotSlot followed by capacity state bytes, one per sensor ID.
+// There is a single writer. It fills slot published % slotCount and then bumps published,
+// so readers always start from the newest complete slot. A slot's sequence is odd while the
+// writer is inside it; a reader that sees it change across its copy throws the copy away.
+// With several slots the writer is normally far from the one being read and readers rarely
+// retry. Everything is little-endian host order: producer and consumers share a machine.
+
+static const char* const DEFAULT_SHARED_SNAPSHOT_NAME = "/kc135_sensor_snapshots";
+static const uint32_t SHARED_SNAPSHOT_MAGIC = 0x4B435353;  // "SSCK"
+static const uint32_t SHARED_SNAPSHOT_VERSION = 1;
+static const size_t SHARED_SNAPSHOT_ALIGNMENT = 64;        // Keeps slots on separate cache lines
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory seqlock needs lock-free 64-bit atomics");
+
+struct SharedSnapshotHeader {
+    std::atomic<uint32_t> magic;     // Written last, once the segment is initialised
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t capacity;               // State bytes per slot
+    uint64_t slotSize;               // Bytes from one slot to the next
+    std::atomic<uint64_t> published; // Snapshots published so far; 0 means none yet
+};
+
+struct SharedSnapshotSlot {
+    std::atomic<uint64_t> sequence;
+    uint64_t generation;             // SensorStateTable generation the states were read at
+    int64_t timestampMs;             // Wall clock at publication, lets readers detect a dead writer
+    uint32_t count;                  // Valid state bytes that follow
+    uint32_t totalCount;             // Sensors the controller has; more than count if capacity ran out
+};
+
+inline size_t sharedSnapshotAlign(size_t bytes) {
+    return (bytes + SHARED_SNAPSHOT_ALIGNMENT - 1) & ~(SHARED_SNAPSHOT_ALIGNMENT - 1);
+}
+
+inline size_t sharedSnapshotSlotSize(uint32_t capacity) {
+    return sharedSnapshotAlign(sizeof(SharedSnapshotSlot) + capacity);
+}
+
+inline size_t sharedSnapshotSegmentSize(uint32_t capacity, uint32_t slotCount) {
+    return sharedSnapshotAlign(sizeof(SharedSnapshotHeader)) + sharedSnapshotSlotSize(capacity) * slotCount;
+}
+
+#endif // SHARED_SNAPSHOT_H
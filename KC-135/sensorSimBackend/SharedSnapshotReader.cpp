@@ -0,0 +1,110 @@
+#include "SharedSnapshotReader.h"
+#include <cstring>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+SharedSnapshotReader::SharedSnapshotReader()
+    : mapping(nullptr), mappingSize(0), header(nullptr) {
+}
+
+SharedSnapshotReader::~SharedSnapshotReader() {
+    close();
+}
+
+bool SharedSnapshotReader::open(const std::string& name) {
+#ifdef _WIN32
+    (void)name;
+    return false;
+#else
+    close();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SharedSnapshotHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    const SharedSnapshotHeader* candidate = static_cast<const SharedSnapshotHeader*>(memory);
+    if (candidate->magic.load(std::memory_order_acquire) != SHARED_SNAPSHOT_MAGIC ||
+        candidate->version != SHARED_SNAPSHOT_VERSION || candidate->slotCount == 0 ||
+        candidate->slotSize < sharedSnapshotSlotSize(candidate->capacity) ||
+        sharedSnapshotAlign(sizeof(SharedSnapshotHeader)) + candidate->slotSize * candidate->slotCount > size) {
+        munmap(memory, size);
+        return false;
+    }
+
+    mapping = memory;
+    mappingSize = size;
+    header = candidate;
+    return true;
+#endif
+}
+
+void SharedSnapshotReader::close() {
+#ifndef _WIN32
+    if (header) munmap(mapping, mappingSize);
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+}
+
+// Newest published slot and the even sequence it had when located, or nullptr if none
+const SharedSnapshotSlot* SharedSnapshotReader::latestSlot(uint64_t& sequence) const {
+    if (!header) return nullptr;
+    for (;;) {
+        uint64_t published = header->published.load(std::memory_order_acquire);
+        if (published == 0) return nullptr;
+
+        const char* base = static_cast<const char*>(mapping) + sharedSnapshotAlign(sizeof(SharedSnapshotHeader));
+        const SharedSnapshotSlot* slot = reinterpret_cast<const SharedSnapshotSlot*>(
+            base + ((published - 1) % header->slotCount) * header->slotSize);
+        sequence = slot->sequence.load(std::memory_order_acquire);
+        // Odd means the writer has lapped the ring and is refilling this slot
+        if ((sequence & 1) == 0) return slot;
+    }
+}
+
+uint64_t SharedSnapshotReader::latestGeneration() const {
+    for (;;) {
+        uint64_t sequence;
+        const SharedSnapshotSlot* slot = latestSlot(sequence);
+        if (!slot) return 0;
+
+        uint64_t generation = slot->generation;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) == sequence) return generation;
+    }
+}
+
+bool SharedSnapshotReader::readLatest(SharedSnapshotData& out) const {
+    for (;;) {
+        uint64_t sequence;
+        const SharedSnapshotSlot* slot = latestSlot(sequence);
+        if (!slot) return false;
+
+        // count is bounded by capacity even if read mid-write, so the copy stays in the slot
+        uint32_t count = slot->count;
+        if (count > header->capacity) count = header->capacity;
+        out.generation = slot->generation;
+        out.timestampMs = slot->timestampMs;
+        out.totalCount = slot->totalCount;
+        out.states.resize(count);
+        std::memcpy(out.states.data(), slot + 1, count);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) == sequence) return true;
+    }
+}
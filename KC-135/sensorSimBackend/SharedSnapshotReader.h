@@ -0,0 +1,50 @@
+#ifndef SHARED_SNAPSHOT_READER_H
+#define SHARED_SNAPSHOT_READER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "SharedSnapshot.h"
+
+struct SharedSnapshotData {
+    uint64_t generation = 0;
+    int64_t timestampMs = 0;
+    uint32_t totalCount = 0;
+    std::vector<uint8_t> states;  // One SensorState byte per sensor ID
+};
+
+// Client side of the controller's shared-memory snapshot ring (link SensorSnapshotReader).
+//
+// After open() every call is a few loads from the mapping: no syscalls and no locks, so a
+// GUI can poll every frame. Readers never write to the segment and cannot slow the
+// controller down. A reader object is not thread-safe; give each thread its own.
+class SharedSnapshotReader {
+private:
+    void* mapping;
+    size_t mappingSize;
+    const SharedSnapshotHeader* header;
+
+    const SharedSnapshotSlot* latestSlot(uint64_t& sequence) const;
+
+public:
+    SharedSnapshotReader();
+    ~SharedSnapshotReader();
+
+    SharedSnapshotReader(const SharedSnapshotReader&) = delete;
+    SharedSnapshotReader& operator=(const SharedSnapshotReader&) = delete;
+
+    // Fails if the segment does not exist yet or has an incompatible layout
+    bool open(const std::string& name = DEFAULT_SHARED_SNAPSHOT_NAME);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    // Generation of the newest snapshot without copying it, 0 if none has been published.
+    // Compare against the last one read to skip unchanged frames.
+    uint64_t latestGeneration() const;
+
+    // Copies the newest snapshot into out, reusing its buffer. Returns false if nothing
+    // has been published yet.
+    bool readLatest(SharedSnapshotData& out) const;
+};
+
+#endif // SHARED_SNAPSHOT_READER_H
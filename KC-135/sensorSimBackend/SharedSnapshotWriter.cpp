@@ -0,0 +1,103 @@
+#include "SharedSnapshotWriter.h"
+#include <algorithm>
+#include <iostream>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+SharedSnapshotWriter::SharedSnapshotWriter()
+    : mapping(nullptr), mappingSize(0), header(nullptr), published(0) {
+}
+
+SharedSnapshotWriter::~SharedSnapshotWriter() {
+    close();
+}
+
+bool SharedSnapshotWriter::create(const std::string& segmentName, uint32_t capacity, uint32_t slotCount) {
+#ifdef _WIN32
+    (void)segmentName;
+    (void)capacity;
+    (void)slotCount;
+    std::cerr << "Shared-memory snapshots are not supported on this platform" << std::endl;
+    return false;
+#else
+    close();
+    if (capacity == 0 || slotCount < 2) return false;
+
+    // A segment left behind by a crashed controller would have a stale layout
+    shm_unlink(segmentName.c_str());
+    int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to create shared memory segment " << segmentName << std::endl;
+        return false;
+    }
+
+    size_t size = sharedSnapshotSegmentSize(capacity, slotCount);
+    if (ftruncate(fd, (off_t)size) != 0) {
+        std::cerr << "Failed to size shared memory segment " << segmentName << std::endl;
+        ::close(fd);
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory segment " << segmentName << std::endl;
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+
+    // ftruncate zero-fills, so every slot starts with an even (idle) sequence
+    name = segmentName;
+    mapping = memory;
+    mappingSize = size;
+    header = static_cast<SharedSnapshotHeader*>(memory);
+    header->version = SHARED_SNAPSHOT_VERSION;
+    header->slotCount = slotCount;
+    header->capacity = capacity;
+    header->slotSize = sharedSnapshotSlotSize(capacity);
+    header->published.store(0, std::memory_order_relaxed);
+    header->magic.store(SHARED_SNAPSHOT_MAGIC, std::memory_order_release);
+    published = 0;
+    return true;
+#endif
+}
+
+void SharedSnapshotWriter::close() {
+#ifndef _WIN32
+    if (!header) return;
+    munmap(mapping, mappingSize);
+    shm_unlink(name.c_str());
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+}
+
+SharedSnapshotSlot* SharedSnapshotWriter::slotAt(uint64_t index) const {
+    char* base = static_cast<char*>(mapping) + sharedSnapshotAlign(sizeof(SharedSnapshotHeader));
+    return reinterpret_cast<SharedSnapshotSlot*>(base + (index % header->slotCount) * header->slotSize);
+}
+
+void SharedSnapshotWriter::publish(SensorStateTable& states, int64_t timestampMs) {
+    if (!header) return;
+
+    SharedSnapshotSlot* slot = slotAt(published);
+    uint64_t seq = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t total = states.size();
+    size_t count = std::min<size_t>(total, header->capacity);
+    slot->generation = states.read(reinterpret_cast<uint8_t*>(slot + 1), count);
+    slot->timestampMs = timestampMs;
+    slot->count = (uint32_t)count;
+    slot->totalCount = (uint32_t)total;
+
+    slot->sequence.store(seq + 2, std::memory_order_release);
+    header->published.store(++published, std::memory_order_release);
+}
@@ -0,0 +1,39 @@
+#ifndef SHARED_SNAPSHOT_WRITER_H
+#define SHARED_SNAPSHOT_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include "SensorStateTable.h"
+#include "SharedSnapshot.h"
+
+// Publishes sensor snapshots into a POSIX shared-memory ring (see SharedSnapshot.h) for
+// consumers on the same host. Not thread-safe: one thread owns the writer.
+class SharedSnapshotWriter {
+private:
+    std::string name;
+    void* mapping;
+    size_t mappingSize;
+    SharedSnapshotHeader* header;
+    uint64_t published;
+
+    SharedSnapshotSlot* slotAt(uint64_t index) const;
+
+public:
+    SharedSnapshotWriter();
+    ~SharedSnapshotWriter();
+
+    SharedSnapshotWriter(const SharedSnapshotWriter&) = delete;
+    SharedSnapshotWriter& operator=(const SharedSnapshotWriter&) = delete;
+
+    // Creates (replacing any stale segment of the same name) and maps the ring.
+    // name follows shm_open rules, e.g. "/kc135_sensor_snapshots". Unsupported on Windows.
+    bool create(const std::string& name, uint32_t capacity, uint32_t slotCount);
+    // Unmaps and unlinks the segment; readers that still have it mapped keep the last snapshot
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    // Copies a consistent snapshot of states into the next slot and makes it the latest
+    void publish(SensorStateTable& states, int64_t timestampMs);
+};
+
+#endif // SHARED_SNAPSHOT_WRITER_H
@@ -0,0 +1,71 @@
+#ifndef SOCKET_COMPAT_H
+#define SOCKET_COMPAT_H
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <arpa/inet.h>
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <cerrno>
+#endif
+
+#ifdef _WIN32
+    typedef SOCKET SocketHandle;
+    #define INVALID_SOCKET_HANDLE INVALID_SOCKET
+#else
+    typedef int SocketHandle;
+    #define INVALID_SOCKET_HANDLE (-1)
+#endif
+
+// Linux raises SIGPIPE when writing to a peer that has gone away; suppress it per call
+#ifdef MSG_NOSIGNAL
+    #define SEND_FLAGS MSG_NOSIGNAL
+#else
+    #define SEND_FLAGS 0
+#endif
+
+inline void closeSocketHandle(SocketHandle socketHandle) {
+#ifdef _WIN32
+    closesocket(socketHandle);
+#else
+    close(socketHandle);
+#endif
+}
+
+inline bool setSocketNonBlocking(SocketHandle socketHandle) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(socketHandle, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(socketHandle, F_GETFL, 0);
+    if (flags < 0) return false;
+    return fcntl(socketHandle, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+// True when the last socket call failed only because it would have blocked
+inline bool socketWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// True when the last socket call was interrupted and should simply be retried
+inline bool socketInterrupted() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEINTR;
+#else
+    return errno == EINTR;
+#endif
+}
+
+#endif // SOCKET_COMPAT_H
@@ -0,0 +1,41 @@
+#ifndef STATUS_FRAME_H
+#define STATUS_FRAME_H
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class FrameCompressor;
+
+// Immutable encoded status message. A broadcast serializes once and every client
+// queue holds a reference to the same frame, so fan-out never copies the payload.
+class StatusFrame {
+private:
+    const std::string bytes;
+    const std::chrono::steady_clock::time_point created;
+
+    // Deflated copy for compressing clients, built by FrameCompressor on first use
+    mutable std::once_flag compressOnce;
+    mutable std::shared_ptr<const StatusFrame> compressedCopy;
+    friend class FrameCompressor;
+
+public:
+    explicit StatusFrame(std::string&& bytes)
+        : bytes(std::move(bytes)), created(std::chrono::steady_clock::now()) {}
+    StatusFrame(std::string&& bytes, std::chrono::steady_clock::time_point created)
+        : bytes(std::move(bytes)), created(created) {}
+
+    const char* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+    // When the frame was encoded, for send latency
+    std::chrono::steady_clock::time_point createdAt() const { return created; }
+};
+
+typedef std::shared_ptr<const StatusFrame> StatusFramePtr;
+
+inline StatusFramePtr makeStatusFrame(std::string bytes) {
+    return std::make_shared<const StatusFrame>(std::move(bytes));
+}
+
+#endif // STATUS_FRAME_H
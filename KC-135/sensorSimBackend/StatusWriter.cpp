@@ -0,0 +1,163 @@
+#include "StatusWriter.h"
+#include <charconv>
+#include <chrono>
+#include <cstring>
+
+StatusWriter::StatusWriter()
+    : sensorsGeneration(0), hasGeneration(false), timestampSecond(-1) {
+    timestamp[0] = '\0';
+}
+
+const std::string& StatusWriter::writeSnapshot(const SensorRegistry& sensors, uint64_t generation, uint64_t sequence,
+                                               size_t connectedClients, const std::vector<SensorId>* subset) {
+    updateSensorsJson(sensors, generation);
+
+    char clients[24];
+    char* clientsEnd = std::to_chars(clients, clients + sizeof(clients), connectedClients).ptr;
+
+    output.clear();
+    output.reserve((subset ? 0 : sensorsJson.size()) + 160);
+    appendHeader("snapshot", sequence);
+    output.append("\"server_status\":\"running\",");
+    output.append("\"connected_clients\":");
+    output.append(clients, clientsEnd);
+    output.append(",\"sensors\":[");
+    if (subset) {
+        // Filtered views are assembled from the same cached fragments
+        for (size_t i = 0; i < subset->size(); ++i) {
+            if (i > 0) output.push_back(',');
+            output.append(fragments[(*subset)[i]].json);
+        }
+    } else {
+        output.append(sensorsJson);
+    }
+    output.append("]}\n");
+    return output;
+}
+
+void StatusWriter::updateSensorsJson(const SensorRegistry& sensors, uint64_t generation) {
+    if (hasGeneration && generation == sensorsGeneration && fragments.size() == sensors.size()) return;
+    updateFragments(sensors);
+
+    size_t length = 0;
+    for (const SensorFragment& fragment : fragments) {
+        length += fragment.json.size() + 1;
+    }
+    sensorsJson.clear();
+    sensorsJson.reserve(length);
+    for (size_t i = 0; i < fragments.size(); ++i) {
+        if (i > 0) sensorsJson.push_back(',');
+        sensorsJson.append(fragments[i].json);
+    }
+
+    sensorsGeneration = generation;
+    hasGeneration = true;
+}
+
+const std::string& StatusWriter::writeDelta(const SensorRegistry& sensors, uint64_t sequence,
+                                            const std::vector<SensorId>& changed) {
+    if (fragments.size() < sensors.size()) {
+        fragments.resize(sensors.size(), SensorFragment{0, 0, std::string()});
+    }
+
+    output.clear();
+    appendHeader("delta", sequence);
+    output.append("\"sensors\":[");
+    for (size_t i = 0; i < changed.size(); ++i) {
+        updateFragment(sensors, changed[i]);
+        if (i > 0) output.push_back(',');
+        output.append(fragments[changed[i]].json);
+    }
+    output.append("]}\n");
+    return output;
+}
+
+void StatusWriter::updateFragments(const SensorRegistry& sensors) {
+    size_t count = sensors.size();
+    if (fragments.size() != count) {
+        fragments.resize(count, SensorFragment{0, 0, std::string()});
+    }
+
+    // Change detection is a scan of the registry's state bytes against the cached ones
+    const uint8_t* states = sensors.stateData();
+    for (SensorId id = 0; id < count; ++id) {
+        if (fragments[id].json.empty() || fragments[id].state != states[id]) {
+            updateFragment(sensors, id);
+        }
+    }
+}
+
+void StatusWriter::updateFragment(const SensorRegistry& sensors, SensorId id) {
+    SensorFragment& fragment = fragments[id];
+    uint8_t state = sensors.stateData()[id];
+
+    if (fragment.json.empty()) {
+        // First sight of this sensor: render and keep the static prefix
+        fragment.json.append("{\"name\":\"");
+        appendEscaped(fragment.json, sensors.getName(id));
+        fragment.json.append("\",\"location\":\"");
+        appendEscaped(fragment.json, sensors.getLocation(id));
+        fragment.json.append("\",\"state\":\"");
+        fragment.prefixLength = fragment.json.size();
+    } else if (fragment.state == state) {
+        return;
+    } else {
+        fragment.json.resize(fragment.prefixLength);
+    }
+
+    fragment.state = state;
+    fragment.json.append(sensorStateName((SensorState)state));
+    fragment.json.append("\"}");
+}
+
+void StatusWriter::updateTimestamp() {
+    std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    if (now == timestampSecond) return;
+
+#ifdef _WIN32
+    ctime_s(timestamp, sizeof(timestamp), &now);
+#else
+    ctime_r(&now, timestamp);
+#endif
+    // Remove newline from ctime
+    size_t length = strlen(timestamp);
+    if (length > 0 && timestamp[length - 1] == '\n') {
+        timestamp[length - 1] = '\0';
+    }
+    timestampSecond = now;
+}
+
+void StatusWriter::appendHeader(const char* type, uint64_t sequence) {
+    updateTimestamp();
+    char digits[24];
+    char* digitsEnd = std::to_chars(digits, digits + sizeof(digits), sequence).ptr;
+
+    output.append("{\"type\":\"");
+    output.append(type);
+    output.append("\",\"seq\":");
+    output.append(digits, digitsEnd);
+    output.append(",\"timestamp\":\"");
+    output.append(timestamp);
+    output.append("\",");
+}
+
+void StatusWriter::appendEscaped(std::string& out, std::string_view value) {
+    static const char HEX[] = "0123456789abcdef";
+    for (char c : value) {
+        switch (c) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    out.append("\\u00");
+                    out.push_back(HEX[(c >> 4) & 0xF]);
+                    out.push_back(HEX[c & 0xF]);
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef STATUS_WRITER_H
+#define STATUS_WRITER_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "SensorRegistry.h"
+
+// Renders the JSON status stream into buffers that are reused between calls.
+//
+// The escaped name/location prefix of every sensor is rendered once and cached with the
+// state it was last written for; only sensors whose state differs are rewritten. The
+// sensors array is reassembled only when the caller's generation counter has moved, and
+// the timestamp string is formatted at most once per second.
+class StatusWriter {
+private:
+    struct SensorFragment {
+        size_t prefixLength;  // Length of {"name":"..","location":"..","state":"
+        uint8_t state;
+        std::string json;     // Complete {...} object for the sensor
+    };
+
+    std::vector<SensorFragment> fragments;
+    std::string sensorsJson;      // Comma-joined fragments for the current generation
+    uint64_t sensorsGeneration;
+    bool hasGeneration;
+
+    std::string output;
+    std::time_t timestampSecond;
+    char timestamp[32];
+
+    void updateFragments(const SensorRegistry& sensors);
+    void updateSensorsJson(const SensorRegistry& sensors, uint64_t generation);
+    void updateFragment(const SensorRegistry& sensors, SensorId id);
+    void updateTimestamp();
+    void appendHeader(const char* type, uint64_t sequence);
+
+public:
+    StatusWriter();
+
+    // Full snapshot. generation must change whenever a sensor is added or changes state.
+    // sequence is the stream position written as "seq". With subset, only those sensors are
+    // listed, in order.
+    const std::string& writeSnapshot(const SensorRegistry& sensors, uint64_t generation, uint64_t sequence,
+                                     size_t connectedClients, const std::vector<SensorId>* subset = nullptr);
+
+    // Only the listed sensors, in order
+    const std::string& writeDelta(const SensorRegistry& sensors, uint64_t sequence,
+                                  const std::vector<SensorId>& changed);
+
+    static void appendEscaped(std::string& out, std::string_view value);
+};
+
+#endif // STATUS_WRITER_H
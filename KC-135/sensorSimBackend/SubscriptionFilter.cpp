@@ -0,0 +1,75 @@
+#include "SubscriptionFilter.h"
+#include <cctype>
+
+SubscriptionFilter::SubscriptionFilter()
+    : stateMask(ALL_STATES) {
+}
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+bool SubscriptionFilter::setStates(const std::string& list) {
+    std::string_view remaining(list);
+    bool invert = !remaining.empty() && remaining[0] == '!';
+    if (invert) remaining.remove_prefix(1);
+
+    uint8_t mask = 0;
+    while (!remaining.empty()) {
+        size_t comma = remaining.find(',');
+        std::string_view name = remaining.substr(0, comma);
+        remaining = comma == std::string_view::npos ? std::string_view() : remaining.substr(comma + 1);
+        if (name.empty()) continue;
+
+        bool known = false;
+        for (uint8_t state = 0; isValidSensorState(state); ++state) {
+            if (equalsIgnoreCase(name, sensorStateName((SensorState)state))) {
+                mask |= (uint8_t)(1u << state);
+                known = true;
+            }
+        }
+        if (!known) return false;
+    }
+
+    stateMask = invert ? (uint8_t)(~mask & ALL_STATES) : mask;
+    return true;
+}
+
+bool SubscriptionFilter::matchesSensor(std::string_view name, std::string_view location) const {
+    return (namePattern.empty() || globMatch(namePattern, name)) &&
+           (locationPattern.empty() || globMatch(locationPattern, location));
+}
+
+std::string SubscriptionFilter::key() const {
+    static const char HEX[] = "0123456789abcdef";
+    std::string result = "name=" + namePattern + " location=" + locationPattern + " states=";
+    result.push_back(HEX[stateMask >> 4]);
+    result.push_back(HEX[stateMask & 0xF]);
+    return result;
+}
+
+// Iterative matcher: on a mismatch, backtrack to the most recent * and let it absorb one more character
+bool SubscriptionFilter::globMatch(std::string_view pattern, std::string_view text) {
+    size_t p = 0, t = 0;
+    size_t starPattern = std::string_view::npos, starText = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            starPattern = p++;
+            starText = t;
+        } else if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            p++;
+            t++;
+        } else if (starPattern != std::string_view::npos) {
+            p = starPattern + 1;
+            t = ++starText;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
@@ -0,0 +1,44 @@
+#ifndef SUBSCRIPTION_FILTER_H
+#define SUBSCRIPTION_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "SensorState.h"
+
+// Which sensors a client subscribed to with "HELLO name=<glob> location=<glob> states=<list>".
+//
+// Globs support * and ?. The state list is comma-separated state names, e.g.
+// "states=Declaring,Degraded"; a leading ! inverts it, so "states=!Operational" selects every
+// sensor that is not operational. Name and location never change, so whether a sensor
+// passes them is fixed; the state test is re-evaluated as states change.
+class SubscriptionFilter {
+public:
+    static const uint8_t ALL_STATES = 0x1F;
+
+private:
+    std::string namePattern;      // Empty matches everything
+    std::string locationPattern;
+    uint8_t stateMask;            // Bit n set = SensorState n passes
+
+public:
+    SubscriptionFilter();
+
+    void setNamePattern(const std::string& pattern) { namePattern = pattern == "*" ? "" : pattern; }
+    void setLocationPattern(const std::string& pattern) { locationPattern = pattern == "*" ? "" : pattern; }
+    // Returns false and leaves the mask alone if the list names an unknown state
+    bool setStates(const std::string& list);
+
+    bool isEmpty() const { return namePattern.empty() && locationPattern.empty() && stateMask == ALL_STATES; }
+    bool hasStateMask() const { return stateMask != ALL_STATES; }
+
+    bool matchesSensor(std::string_view name, std::string_view location) const;
+    bool matchesState(uint8_t state) const { return state < 8 && (stateMask >> state) & 1; }
+
+    // Canonical form; clients with equal keys receive the same frames
+    std::string key() const;
+
+    static bool globMatch(std::string_view pattern, std::string_view text);
+};
+
+#endif // SUBSCRIPTION_FILTER_H
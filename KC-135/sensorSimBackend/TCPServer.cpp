@@ -1,21 +1,57 @@
 #include "TCPServer.h"
+#include "BinaryProtocol.h"
+#include "FrameCompressor.h"
+#include "Metrics.h"
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
-#include <ctime>
 
 #ifdef _WIN32
     #pragma comment(lib, "ws2_32.lib")
     #pragma comment(lib, "wsock32.lib")
+#else
+    #include <sys/uio.h>
 #endif
 
-TCPServer::TCPServer(int port) : port(port), isRunning(false) {
-#ifdef _WIN32
-    serverSocket = INVALID_SOCKET;
-#else
-    serverSocket = -1;
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    #include <linux/errqueue.h>
+    #define TCP_SERVER_ZEROCOPY 1
+#endif
+
+#ifdef URING_TRANSPORT_SUPPORTED
+// Submission queue depth per IO thread; a broadcast to more clients submits in several batches
+static const unsigned URING_ENTRIES = 4096;
+// Large frames registered per IO thread at a time for zero-copy sends
+static const uint32_t URING_BUFFER_SLOTS = 32;
 #endif
+
+// Upper bound on frames gathered into a single sendmsg/WSASend call
+static const size_t MAX_SEND_BATCH = 64;
+
+// Range a client may request with "rate=" in its HELLO line
+static const double MIN_UPDATE_RATE = 1.0;
+static const double MAX_UPDATE_RATE = 1000.0;
+
+// How long a new client has to send its HELLO before it is sent a JSON keyframe anyway. A
+// client that asks for binary, a filter or a resume right away never pays for that keyframe.
+static const std::chrono::milliseconds HELLO_WAIT(50);
+
+static int64_t currentTimeMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+TCPServer::TCPServer(int port)
+    : port(port), ioThreadCount(1), listenBacklog(SOMAXCONN), ioBackend(IOBackend::Sockets), clientCount(0),
+      isRunning(false),
+      streamId((uint64_t)currentTimeMs()), broadcastSequence(0), hasPendingIngest(false), hasPendingChanges(false), resyncRequested(false),
+      maxQueuedMessages(8),
+      slowConsumerPolicy(SlowConsumerPolicy::DropOldest),
+      keyframeInterval(std::chrono::seconds(5)), zeroCopyThreshold(0) {
+    broadcastClients[0] = 0;
+    broadcastClients[1] = 0;
 #ifdef _WIN32
     WSADATA wsaData;
     if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
@@ -33,34 +69,86 @@ TCPServer::~TCPServer() {
 }
 
 bool TCPServer::startServer() {
-    // Create socket
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-#ifdef _WIN32
-    if (serverSocket == INVALID_SOCKET) {
+    if (isRunning) return false;
+
+    size_t shardCount = ioThreadCount;
+#ifndef SO_REUSEPORT
+    shardCount = 1;
+#endif
+
+    std::vector<std::unique_ptr<IOShard>> opened;
+    for (size_t i = 0; i < shardCount; ++i) {
+        std::unique_ptr<IOShard> shard(new IOShard());
+        shard->index = i;
+        if (!openListener(*shard)) {
+            for (auto& openedShard : opened) {
+                closeShard(*openedShard);
+            }
+            return false;
+        }
+        opened.push_back(std::move(shard));
+    }
+
+    bool uring = false;
+    if (ioBackend == IOBackend::IoUring) {
+#ifdef URING_TRANSPORT_SUPPORTED
+        uring = true;
+        for (auto& shard : opened) {
+            uring = openUring(*shard) && uring;
+        }
+        if (!uring) std::cerr << "io_uring unavailable, using socket IO" << std::endl;
 #else
-    if (serverSocket < 0) {
+        std::cerr << "io_uring not supported in this build, using socket IO" << std::endl;
 #endif
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        publishedStats.assign(opened.size(), std::vector<ClientStats>());
+    }
+    {
+        std::lock_guard<std::mutex> lock(changesMutex);
+        shards.swap(opened);
+    }
+
+    isRunning = true;
+    
+    // Each IO thread accepts, reads and flushes its own clients; shard 0 also broadcasts
+    for (auto& shard : shards) {
+        shard->thread = std::thread(&TCPServer::runEventLoop, this, std::ref(*shard));
+    }
+    
+    std::cout << "TCP Server started on port " << port;
+    if (shards.size() > 1) std::cout << " with " << shards.size() << " IO threads";
+    if (uring) std::cout << " using io_uring";
+    std::cout << std::endl;
+    return true;
+}
+
+bool TCPServer::openListener(IOShard& shard) {
+    // Create socket
+    shard.listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (shard.listenSocket == INVALID_SOCKET_HANDLE) {
         std::cerr << "Failed to create socket" << std::endl;
         return false;
     }
 
     // Set socket options to reuse address
     int opt = 1;
-#ifdef _WIN32
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, (char*)&opt, sizeof(opt)) < 0) {
-#else
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-#endif
+    if (setsockopt(shard.listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt)) < 0) {
         std::cerr << "Failed to set socket options" << std::endl;
-#ifdef _WIN32
-        closesocket(serverSocket);
-        serverSocket = INVALID_SOCKET;
-#else
-        close(serverSocket);
-        serverSocket = -1;
-#endif
+        closeShard(shard);
         return false;
     }
+#ifdef SO_REUSEPORT
+    // Lets every shard bind the same port; the kernel balances connections between them
+    if (ioThreadCount > 1 &&
+        setsockopt(shard.listenSocket, SOL_SOCKET, SO_REUSEPORT, (const char*)&opt, sizeof(opt)) < 0) {
+        std::cerr << "Failed to enable SO_REUSEPORT" << std::endl;
+        closeShard(shard);
+        return false;
+    }
+#endif
 
     // Bind socket
     struct sockaddr_in serverAddr;
@@ -69,88 +157,172 @@ bool TCPServer::startServer() {
     serverAddr.sin_addr.s_addr = INADDR_ANY;
     serverAddr.sin_port = htons(port);
 
-    if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+    if (bind(shard.listenSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
         std::cerr << "Failed to bind socket to port " << port << std::endl;
-#ifdef _WIN32
-        closesocket(serverSocket);
-        serverSocket = INVALID_SOCKET;
-#else
-        close(serverSocket);
-        serverSocket = -1;
-#endif
+        closeShard(shard);
         return false;
     }
 
     // Listen for connections
-    if (listen(serverSocket, 5) < 0) {
+    if (listen(shard.listenSocket, listenBacklog) < 0) {
         std::cerr << "Failed to listen on socket" << std::endl;
-#ifdef _WIN32
-        closesocket(serverSocket);
-        serverSocket = INVALID_SOCKET;
-#else
-        close(serverSocket);
-        serverSocket = -1;
-#endif
+        closeShard(shard);
         return false;
     }
 
-    isRunning = true;
-    
-    // Start server thread for accepting clients
-    serverThread = std::thread(&TCPServer::acceptClients, this);
-    
-    // Start status broadcasting thread
-    statusThread = std::thread(&TCPServer::sendStatusMessages, this);
-    
-    std::cout << "TCP Server started on port " << port << std::endl;
+    // The event loop never blocks on a single socket
+    if (!setSocketNonBlocking(shard.listenSocket) || !shard.reactor.open() ||
+        !shard.reactor.add(shard.listenSocket, Reactor::Readable)) {
+        std::cerr << "Failed to initialize event loop" << std::endl;
+        closeShard(shard);
+        return false;
+    }
     return true;
 }
 
+void TCPServer::closeShard(IOShard& shard) {
+#ifdef URING_TRANSPORT_SUPPORTED
+    // Cancels whatever is still in flight before the frames it reads are released
+    shard.uring.close();
+    shard.uringOps.clear();
+    shard.registeredFrames.clear();
+    shard.registeredSlots.clear();
+#endif
+
+    // Close all client sockets
+    for (auto& entry : shard.clients) {
+        closeSocketHandle(entry.first);
+    }
+    shard.clients.clear();
+
+    // Close server socket
+    if (shard.listenSocket != INVALID_SOCKET_HANDLE) {
+        closeSocketHandle(shard.listenSocket);
+        shard.listenSocket = INVALID_SOCKET_HANDLE;
+    }
+    shard.reactor.close();
+}
+
 void TCPServer::stopServer() {
     if (!isRunning) return;
     
     isRunning = false;
-
-    // Close server socket
-#ifdef _WIN32
-    if (serverSocket != INVALID_SOCKET) {
-        closesocket(serverSocket);
-        serverSocket = INVALID_SOCKET;
-    }
-#else
-    if (serverSocket >= 0) {
-        close(serverSocket);
-        serverSocket = -1;
+    for (auto& shard : shards) {
+        shard->reactor.wakeup();
     }
-#endif
 
-    // Close all client sockets
-    {
-        std::lock_guard<std::mutex> lock(clientsMutex);
-#ifdef _WIN32
-        for (SOCKET clientSocket : clientSockets) {
-            closesocket(clientSocket);
-        }
-#else
-        for (int clientSocket : clientSockets) {
-            close(clientSocket);
+    // Wait for the IO threads to finish before touching their state
+    for (auto& shard : shards) {
+        if (shard->thread.joinable()) {
+            shard->thread.join();
         }
-#endif
-        clientSockets.clear();
     }
 
-    // Wait for threads to finish
-    if (serverThread.joinable()) {
-        serverThread.join();
+    for (auto& shard : shards) {
+        closeShard(*shard);
     }
-    if (statusThread.joinable()) {
-        statusThread.join();
+    {
+        std::lock_guard<std::mutex> lock(changesMutex);
+        shards.clear();
     }
+    clientCount = 0;
+    broadcastClients[0] = 0;
+    broadcastClients[1] = 0;
 
     std::cout << "TCP Server stopped" << std::endl;
 }
 
-void TCPServer::acceptClients() {
+void TCPServer::runEventLoop(IOShard& shard) {
+    bool primary = shard.index == 0;
+    std::vector<Reactor::Event> ready;
+    auto nextKeyframe = std::chrono::steady_clock::now();
+    shard.lastStatsTime = nextKeyframe;
+    auto nextStats = shard.lastStatsTime + std::chrono::seconds(1);
+
+    while (isRunning) {
+        // State changes are pushed as soon as the loop wakes up, and held ones once released
+        auto now = std::chrono::steady_clock::now();
+        TimerWheel::Clock::time_point released;
+        if (primary && (hasPendingChanges || (damper.nextDeadline(released) && released <= now))) {
+            broadcastChanges(shard);
+            now = std::chrono::steady_clock::now();
+        }
+
+        if (primary && now >= nextKeyframe) {
+            // Brings clients that dropped a delta up to date too
+            resyncRequested = false;
+            broadcastStatus(shard);
+            // Absolute deadlines so the period does not drift with broadcast cost
+            nextKeyframe += keyframeInterval;
+            if (nextKeyframe <= now) {
+                nextKeyframe = now + keyframeInterval;
+            }
+        } else if (primary && resyncRequested.exchange(false)) {
+            broadcastResync(shard);
+        }
+        sendPeriodicUpdates(shard, now);
+        if (now >= nextStats) {
+            publishClientStats(shard, now);
+            nextStats = now + std::chrono::seconds(1);
+        }
+
+        // One timer covers the keyframe, stats and every client's next update
+        auto deadline = primary ? std::min(nextKeyframe, nextStats) : nextStats;
+        TimerWheel::Clock::time_point nextUpdate;
+        if (shard.updateTimers.nextDeadline(nextUpdate)) {
+            deadline = std::min(deadline, nextUpdate);
+        }
+        if (primary && damper.nextDeadline(released)) {
+            deadline = std::min(deadline, released);
+        }
+        shard.reactor.setDeadline(deadline);
+
+#ifdef URING_TRANSPORT_SUPPORTED
+        // Everything this pass queued, e.g. a send per client for a broadcast, in one syscall
+        if (shard.uring.isOpen()) shard.uring.submit();
+#endif
+
+        if (shard.reactor.wait(ready, -1) < 0) {
+            std::cerr << "Event loop wait failed" << std::endl;
+            break;
+        }
+
+#ifdef URING_TRANSPORT_SUPPORTED
+        if (shard.uring.isOpen()) handleUringCompletions(shard);
+#endif
+
+        if (shard.hasInbox) {
+            deliverBroadcasts(shard);
+        }
+
+        for (const Reactor::Event& event : ready) {
+            if (event.socket == shard.listenSocket) {
+                acceptClients(shard);
+                continue;
+            }
+
+            auto it = shard.clients.find(event.socket);
+            if (it == shard.clients.end()) continue;
+            ClientConnection& client = it->second;
+
+            if ((event.events & Reactor::Error) && client.zeroCopyEnabled) {
+                reapZeroCopyCompletions(client);
+            }
+            if (event.events & (Reactor::Readable | Reactor::Closed | Reactor::Error)) {
+                handleReadable(client);
+                if (shard.clients.find(event.socket) == shard.clients.end()) continue;
+            }
+            if (event.events & Reactor::Writable) {
+                if (!flushClient(client)) {
+                    removeDisconnectedClient(shard, event.socket);
+                }
+            }
+        }
+    }
+}
+
+void TCPServer::acceptClients(IOShard& shard) {
+    // Drain the whole accept backlog; the listening socket is non-blocking
     while (isRunning) {
         struct sockaddr_in clientAddr;
 #ifdef _WIN32
@@ -159,142 +331,1292 @@ void TCPServer::acceptClients() {
         socklen_t clientAddrLen = sizeof(clientAddr);
 #endif
         
-#ifdef _WIN32
-        SOCKET clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
-        if (clientSocket == INVALID_SOCKET) {
-#else
-        int clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
-        if (clientSocket < 0) {
-#endif
-            if (isRunning) {
+        SocketHandle clientSocket = accept(shard.listenSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
+        if (clientSocket == INVALID_SOCKET_HANDLE) {
+            if (socketInterrupted()) continue;
+            if (!socketWouldBlock()) {
                 std::cerr << "Failed to accept client connection" << std::endl;
             }
-            continue;
+            return;
         }
+        addClient(shard, clientSocket, clientAddr);
+    }
+}
 
-        {
-            std::lock_guard<std::mutex> lock(clientsMutex);
-            clientSockets.push_back(clientSocket);
+void TCPServer::addClient(IOShard& shard, SocketHandle clientSocket, const struct sockaddr_in& clientAddr) {
+    if (!setSocketNonBlocking(clientSocket) || !shard.reactor.add(clientSocket, Reactor::Readable)) {
+        std::cerr << "Failed to register client connection" << std::endl;
+        closeSocketHandle(clientSocket);
+        return;
+    }
+
+    char clientIP[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &(clientAddr.sin_addr), clientIP, INET_ADDRSTRLEN);
+
+    ClientConnection client;
+    client.socket = clientSocket;
+    client.shard = &shard;
+    client.connectionId = shard.nextConnectionId++;
+    client.address = std::string(clientIP) + ":" + std::to_string(ntohs(clientAddr.sin_port));
+#ifdef TCP_SERVER_ZEROCOPY
+    bool socketSends = true;
+#ifdef URING_TRANSPORT_SUPPORTED
+    socketSends = !shard.uring.isOpen();
+#endif
+    if (zeroCopyThreshold > 0 && socketSends) {
+        int one = 1;
+        client.zeroCopyEnabled = setsockopt(clientSocket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    }
+#endif
+    std::cout << "Client connected from " << client.address << std::endl;
+
+    // Nothing is sent until the client's HELLO or the end of the wait, whichever is first
+    client.awaitingHello = true;
+    client.updateTimerCookie = shard.nextTimerCookie++;
+    shard.updateTimers.schedule((uint64_t)clientSocket, client.updateTimerCookie,
+                                TimerWheel::Clock::now() + HELLO_WAIT);
+
+    clientCount++;
+    Metrics::add(MetricCounter::ClientsAccepted);
+    countBroadcastClient(client, 1);
+    shard.clients.emplace(clientSocket, std::move(client));
+}
+
+// Keyframe for a client that did not send a HELLO, so subsequent deltas can be applied
+bool TCPServer::sendInitialSnapshot(ClientConnection& client) {
+    client.awaitingHello = false;
+    StatusFramePtr keyframe = makeStatusFrame(generateClientKeyframe(client));
+    return enqueueMessage(client, keyframe, FrameKind::Keyframe) && flushClient(client);
+}
+
+// Tracks which encodings the primary has to build for broadcasts
+void TCPServer::countBroadcastClient(const ClientConnection& client, int delta) {
+    if (client.updateRate > 0) return;
+    std::atomic<size_t>* counts = client.filter ? client.filter->broadcastClients : broadcastClients;
+    counts[(size_t)client.protocol] += (size_t)delta;
+}
+
+// Each encoding is only generated when at least one client uses it
+bool TCPServer::anyClientUses(StatusProtocol protocol) const {
+    return broadcastClients[(size_t)protocol] > 0;
+}
+
+void TCPServer::broadcastStatus(IOShard& primary) {
+    // Also refreshes the shared-memory timestamp, which readers use to tell the controller is alive
+    sharedSnapshots.publish(liveStates, currentTimeMs());
+    if (clientCount == 0) return;
+
+    BroadcastFrames frames;
+    {
+        EncodeLock lock(*this);
+        seedBroadcastStates();
+        uint64_t generation = refreshStates();
+        frames.sequence = ++broadcastSequence;
+        frames.keyframe = true;
+
+        // Changes not yet sent as a delta reach clients through this keyframe; a client
+        // resuming from before it needs them too
+        const uint8_t* states = sensors.stateData();
+        std::vector<SensorId> changed;
+        std::vector<uint8_t> previous;
+        for (SensorId id = 0; id < sensors.size(); ++id) {
+            if (broadcastStates[id] == states[id]) continue;
+            changed.push_back(id);
+            previous.push_back(broadcastStates[id]);
+            broadcastStates[id] = states[id];
+        }
+        if (!changed.empty()) {
+            replay.record(frames.sequence, changed, previous.data());
+            journalChanges(changed, previous.data());
         }
 
-        char clientIP[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &(clientAddr.sin_addr), clientIP, INET_ADDRSTRLEN);
-        std::cout << "Client connected from " << clientIP << ":" << ntohs(clientAddr.sin_port) << std::endl;
+        encodeKeyframes(frames, generation);
     }
+    postBroadcast(primary, frames);
 }
 
-void TCPServer::sendStatusMessages() {
-    while (isRunning) {
-        std::string statusMessage = generateStatusMessage();
-        
+// Clients that dropped a delta wait for this rather than each encoding a keyframe of their
+// own, so however many fall behind at once it costs one encode per protocol and filter. It
+// repeats no sequence number: deltas up to the current one have already been posted ahead of it.
+void TCPServer::broadcastResync(IOShard& primary) {
+    BroadcastFrames frames;
+    {
+        EncodeLock lock(*this);
+        uint64_t generation = refreshStates();
+        frames.sequence = broadcastSequence;
+        frames.keyframe = true;
+        frames.resync = true;
+        encodeKeyframes(frames, generation);
+    }
+    postBroadcast(primary, frames);
+}
+
+// Full state in each encoding some broadcast client uses; requires EncodeLock
+void TCPServer::encodeKeyframes(BroadcastFrames& frames, uint64_t generation) {
+    if (anyClientUses(StatusProtocol::Json)) frames.json = makeStatusFrame(generateStatusMessage(generation));
+    if (anyClientUses(StatusProtocol::Binary)) frames.binary = makeStatusFrame(generateBinarySnapshot());
+    for (FilterGroupPtr& group : broadcastFilterGroups()) {
+        FilteredFrames filtered{group, nullptr, nullptr};
+        if (group->broadcastClients[(size_t)StatusProtocol::Json] > 0) {
+            filtered.json = makeStatusFrame(generateStatusMessage(generation, group.get()));
+        }
+        if (group->broadcastClients[(size_t)StatusProtocol::Binary] > 0) {
+            filtered.binary = makeStatusFrame(generateBinarySnapshot(group.get()));
+        }
+        frames.filtered.push_back(std::move(filtered));
+    }
+}
+
+// Called by any IO thread; the first request wakes the primary and later ones share its resync
+void TCPServer::requestResync() {
+    if (!resyncRequested.exchange(true)) {
+        shards[0]->reactor.wakeup();
+    }
+}
+
+void TCPServer::broadcastChanges(IOShard& primary) {
+    std::vector<SensorId> queued;
+    std::vector<uint32_t> transitions;
+    bool ingested;
+    std::chrono::steady_clock::time_point ingestedAt;
+    {
+        std::lock_guard<std::mutex> lock(changesMutex);
+        queued.swap(pendingChanges);
+        transitions.reserve(queued.size());
+        for (SensorId id : queued) {
+            changePending[id] = false;
+            transitions.push_back(pendingTransitions[id]);
+            pendingTransitions[id] = 0;
+        }
+        hasPendingChanges = false;
+        ingested = hasPendingIngest;
+        ingestedAt = pendingIngestAt;
+        hasPendingIngest = false;
+    }
+
+    // Sensors still inside their coalescing window or flap-damped wait for a later pass
+    std::vector<SensorId> changed;
+    auto now = TimerWheel::Clock::now();
+    damper.release(now, changed);
+    damper.filter(queued, transitions, now, changed);
+    if (changed.empty()) return;
+    sharedSnapshots.publish(liveStates, currentTimeMs());
+
+    BroadcastFrames frames;
+    {
+        // Every encoding reads the same refreshed states
+        EncodeLock lock(*this);
+        seedBroadcastStates();
+        refreshStates(changed);
+
+        // Recorded even with nobody connected, since that is when a lone client reconnects.
+        // A state-filtered client also needs the sensors that just left its view. A sensor
+        // that changed back to the state clients already have is left out.
+        const uint8_t* states = sensors.stateData();
+        std::vector<uint8_t> previous;
+        previous.reserve(changed.size());
+        size_t kept = 0;
+        for (SensorId id : changed) {
+            if (broadcastStates[id] == states[id]) continue;
+            changed[kept++] = id;
+            previous.push_back(broadcastStates[id]);
+            broadcastStates[id] = states[id];
+        }
+        if (kept < changed.size()) Metrics::add(MetricCounter::StateChangesCoalesced, changed.size() - kept);
+        changed.resize(kept);
+        if (changed.empty()) return;
+        frames.sequence = ++broadcastSequence;
+        replay.record(frames.sequence, changed, previous.data());
+        journalChanges(changed, previous.data());
+        if (clientCount == 0) return;
+
+        if (anyClientUses(StatusProtocol::Json)) frames.json = makeStatusFrame(generateDeltaMessage(changed));
+        if (anyClientUses(StatusProtocol::Binary)) frames.binary = makeStatusFrame(generateBinaryDelta(changed));
+
+        std::vector<SensorId> visible;
+        for (FilterGroupPtr& group : broadcastFilterGroups()) {
+            FilteredFrames filtered{group, nullptr, nullptr};
+            updateSensorMatches(*group);
+            visible.clear();
+            for (size_t i = 0; i < changed.size(); ++i) {
+                SensorId id = changed[i];
+                if (group->sensorMatches[id] &&
+                    (group->filter.matchesState(states[id]) || group->filter.matchesState(previous[i]))) {
+                    visible.push_back(id);
+                }
+            }
+            if (!visible.empty() && group->broadcastClients[(size_t)StatusProtocol::Json] > 0) {
+                filtered.json = makeStatusFrame(generateDeltaMessage(visible));
+            }
+            if (!visible.empty() && group->broadcastClients[(size_t)StatusProtocol::Binary] > 0) {
+                filtered.binary = makeStatusFrame(generateBinaryDelta(visible));
+            }
+            frames.filtered.push_back(std::move(filtered));
+        }
+    }
+    postBroadcast(primary, frames);
+    if (ingested) {
+        auto latency = std::chrono::steady_clock::now() - ingestedAt;
+        Metrics::record(MetricHistogram::IngestToBroadcastNs,
+                        (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+    }
+}
+
+// Sends to the primary's own clients directly and queues the frames for every other shard
+void TCPServer::postBroadcast(IOShard& primary, const BroadcastFrames& frames) {
+    for (auto& shard : shards) {
+        if (shard.get() == &primary) continue;
         {
-            std::lock_guard<std::mutex> lock(clientsMutex);
-#ifdef _WIN32
-            std::vector<SOCKET> disconnectedClients;
-            
-            for (SOCKET clientSocket : clientSockets) {
-                int result = send(clientSocket, statusMessage.c_str(), (int)statusMessage.length(), 0);
-#else
-            std::vector<int> disconnectedClients;
-            
-            for (int clientSocket : clientSockets) {
-                int result = send(clientSocket, statusMessage.c_str(), statusMessage.length(), 0);
-#endif
-                if (result < 0) {
-                    std::cout << "Client disconnected" << std::endl;
-                    disconnectedClients.push_back(clientSocket);
+            std::lock_guard<std::mutex> lock(shard->inboxMutex);
+            shard->inbox.push_back(frames);
+            shard->hasInbox = true;
+        }
+        shard->reactor.wakeup();
+    }
+    broadcastMessage(primary, frames);
+}
+
+void TCPServer::deliverBroadcasts(IOShard& shard) {
+    std::vector<BroadcastFrames> inbox;
+    {
+        std::lock_guard<std::mutex> lock(shard.inboxMutex);
+        inbox.swap(shard.inbox);
+        shard.hasInbox = false;
+    }
+    for (const BroadcastFrames& frames : inbox) {
+        broadcastMessage(shard, frames);
+    }
+}
+
+void TCPServer::broadcastMessage(IOShard& shard, const BroadcastFrames& frames) {
+    std::vector<SocketHandle> disconnectedClients;
+    for (auto& entry : shard.clients) {
+        ClientConnection& client = entry.second;
+        // Rate-subscribed clients are served from their own timer instead, and a client still
+        // in its handshake has no keyframe to apply deltas to
+        if (client.updateRate > 0 || client.awaitingHello) continue;
+        // Already reflected in the last snapshot the client was sent. That also covers a
+        // client whose protocol changed after the frames were encoded.
+        if (frames.sequence <= client.coveredSequence && !frames.resync) continue;
+        // A resync is only for clients that lost a delta, and those apply nothing else until
+        // a keyframe arrives
+        if (frames.resync ? !client.needsKeyframe : client.needsKeyframe && !frames.keyframe) continue;
+
+        bool binary = client.protocol == StatusProtocol::Binary;
+        StatusFramePtr frame = binary ? frames.binary : frames.json;
+        if (client.filter) {
+            frame = nullptr;
+            for (const FilteredFrames& filtered : frames.filtered) {
+                if (filtered.group == client.filter) {
+                    frame = binary ? filtered.binary : filtered.json;
+                    break;
                 }
             }
-            
-            // Remove disconnected clients
-#ifdef _WIN32
-            for (SOCKET disconnectedSocket : disconnectedClients) {
-#else
-            for (int disconnectedSocket : disconnectedClients) {
-#endif
-                removeDisconnectedClient(disconnectedSocket);
+        }
+        // Nothing for this client, e.g. no changed sensor passes its filter
+        if (!frame) continue;
+
+        FrameKind kind = frames.keyframe ? FrameKind::Keyframe : FrameKind::Delta;
+        bool queued = (!binary || enqueueDictionary(client)) && enqueueMessage(client, frame, kind);
+        if (!queued || !flushClient(client)) {
+            disconnectedClients.push_back(entry.first);
+        }
+    }
+
+    // Remove disconnected clients
+    for (SocketHandle disconnectedSocket : disconnectedClients) {
+        removeDisconnectedClient(shard, disconnectedSocket);
+    }
+}
+
+void TCPServer::sendPeriodicUpdates(IOShard& shard, TimerWheel::Clock::time_point now) {
+    std::vector<TimerWheel::Timer> expired;
+    shard.updateTimers.expire(now, expired);
+    if (expired.empty()) return;
+
+    // Clients due in the same pass share one frame per filter and protocol
+    struct DueFrames {
+        FilterGroup* filter;
+        StatusFramePtr json;
+        StatusFramePtr binary;
+    };
+    std::vector<DueFrames> due;
+    std::vector<SocketHandle> disconnectedClients;
+    for (const TimerWheel::Timer& timer : expired) {
+        auto it = shard.clients.find((SocketHandle)timer.id);
+        if (it == shard.clients.end() || it->second.updateTimerCookie != timer.cookie) continue;
+        ClientConnection& client = it->second;
+        if (client.awaitingHello) {
+            if (!sendInitialSnapshot(client)) disconnectedClients.push_back(it->first);
+            continue;
+        }
+
+        FilterGroup* filter = client.filter.get();
+        auto cached = std::find_if(due.begin(), due.end(),
+                                   [filter](const DueFrames& frames) { return frames.filter == filter; });
+        if (cached == due.end()) {
+            due.push_back({filter, nullptr, nullptr});
+            cached = due.end() - 1;
+        }
+
+        bool binary = client.protocol == StatusProtocol::Binary;
+        StatusFramePtr& frame = binary ? cached->binary : cached->json;
+        if (!frame) {
+            EncodeLock lock(*this);
+            uint64_t generation = refreshStates();
+            frame = makeStatusFrame(binary ? generateBinarySnapshot(filter) : generateStatusMessage(generation, filter));
+        }
+
+        bool queued = (!binary || enqueueDictionary(client)) && enqueueMessage(client, frame, FrameKind::Keyframe);
+        if (!queued || !flushClient(client)) {
+            disconnectedClients.push_back(it->first);
+            continue;
+        }
+        client.updatesSent++;
+
+        // Next deadline is relative to the previous one, not to now, so the rate never drifts.
+        // Ticks missed while the loop was busy are skipped rather than sent in a burst.
+        client.nextUpdate += client.updatePeriod;
+        if (client.nextUpdate <= now) {
+            auto behind = now - client.nextUpdate;
+            client.nextUpdate += (behind / client.updatePeriod + 1) * client.updatePeriod;
+        }
+        shard.updateTimers.schedule((uint64_t)it->first, client.updateTimerCookie, client.nextUpdate);
+    }
+
+    for (SocketHandle disconnectedSocket : disconnectedClients) {
+        removeDisconnectedClient(shard, disconnectedSocket);
+    }
+}
+
+void TCPServer::scheduleUpdates(ClientConnection& client, double rate) {
+    // A new cookie orphans any timer still queued for the previous rate
+    IOShard& shard = *client.shard;
+    client.updateTimerCookie = shard.nextTimerCookie++;
+    client.updateRate = rate;
+    if (rate <= 0) return;
+
+    client.updatePeriod = std::chrono::nanoseconds((long long)(1e9 / rate));
+    client.nextUpdate = TimerWheel::Clock::now() + client.updatePeriod;
+    client.updatesAtLastStats = client.updatesSent;
+    shard.updateTimers.schedule((uint64_t)client.socket, client.updateTimerCookie, client.nextUpdate);
+}
+
+void TCPServer::publishClientStats(IOShard& shard, TimerWheel::Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - shard.lastStatsTime).count();
+    shard.lastStatsTime = now;
+
+    std::vector<ClientStats> stats;
+    stats.reserve(shard.clients.size());
+    for (auto& entry : shard.clients) {
+        ClientConnection& client = entry.second;
+        if (elapsed > 0) {
+            client.achievedRate = (double)(client.updatesSent - client.updatesAtLastStats) / elapsed;
+        }
+        client.updatesAtLastStats = client.updatesSent;
+
+        stats.push_back({client.address, client.protocol, client.updateRate, client.achievedRate,
+                         client.messagesSent, client.droppedMessages, client.outQueue.size()});
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    publishedStats[shard.index].swap(stats);
+}
+
+void TCPServer::handleReadable(ClientConnection& client) {
+    // Commands are short newline-terminated lines; anything longer is a misbehaving client
+    static const size_t MAX_COMMAND_LENGTH = 1024;
+
+    char buffer[512];
+    while (true) {
+        int bytesReceived = (int)recv(client.socket, buffer, sizeof(buffer), 0);
+        if (bytesReceived > 0) {
+            client.inBuffer.append(buffer, (size_t)bytesReceived);
+
+            size_t newline;
+            while ((newline = client.inBuffer.find('\n')) != std::string::npos) {
+                std::string line = client.inBuffer.substr(0, newline);
+                client.inBuffer.erase(0, newline + 1);
+                if (!handleCommand(client, line)) {
+                    removeDisconnectedClient(*client.shard, client.socket);
+                    return;
+                }
+            }
+
+            if (client.inBuffer.size() > MAX_COMMAND_LENGTH) {
+                std::cout << "Dropping client " << client.address << ": command too long" << std::endl;
+                removeDisconnectedClient(*client.shard, client.socket);
+                return;
             }
+            continue;
         }
-        
-        // Sleep for 1 second (1Hz frequency)
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (bytesReceived < 0 && socketInterrupted()) continue;
+        if (bytesReceived < 0 && socketWouldBlock()) return;
+
+        std::cout << "Client disconnected" << std::endl;
+        removeDisconnectedClient(*client.shard, client.socket);
+        return;
     }
 }
 
+bool TCPServer::handleCommand(ClientConnection& client, const std::string& line) {
+    std::istringstream iss(line);
+    std::string verb;
+    iss >> verb;
+    if (verb != "HELLO") {
+        // Unknown commands are ignored so older servers tolerate newer clients
+        return true;
+    }
+
+    if (client.awaitingHello) {
+        // Cancels the keyframe timer; the reply below brings the client up to date instead
+        client.awaitingHello = false;
+        client.updateTimerCookie = client.shard->nextTimerCookie++;
+    }
+
+    countBroadcastClient(client, -1);
+    SubscriptionFilter filter = client.filter ? client.filter->filter : SubscriptionFilter();
+    bool filterChanged = false;
+    bool compress = client.compressed;
+    bool resumeRequested = false;
+    uint64_t resumeStream = 0;
+    uint64_t resumeSequence = 0;
+    std::string option;
+    while (iss >> option) {
+        size_t equals = option.find('=');
+        if (equals == std::string::npos) continue;
+        std::string key = option.substr(0, equals);
+        std::string value = option.substr(equals + 1);
+
+        if (key == "protocol") {
+            client.protocol = value == "binary" ? StatusProtocol::Binary : StatusProtocol::Json;
+        } else if (key == "compress") {
+            compress = value == "deflate" && FrameCompressor::available();
+        } else if (key == "rate") {
+            double rate = std::atof(value.c_str());
+            if (rate > 0) rate = std::min(std::max(rate, MIN_UPDATE_RATE), MAX_UPDATE_RATE);
+            scheduleUpdates(client, std::max(rate, 0.0));
+        } else if (key == "name") {
+            filter.setNamePattern(value);
+            filterChanged = true;
+        } else if (key == "location") {
+            filter.setLocationPattern(value);
+            filterChanged = true;
+        } else if (key == "states") {
+            filterChanged = filter.setStates(value) || filterChanged;
+        } else if (key == "resume") {
+            // <stream>:<seq> from the hello and last frame of the previous connection
+            char* end = nullptr;
+            resumeStream = std::strtoull(value.c_str(), &end, 10);
+            if (*end == ':') {
+                resumeSequence = std::strtoull(end + 1, &end, 10);
+                resumeRequested = *end == '\0';
+            }
+        }
+    }
+    if (filterChanged) {
+        client.filter = filter.isEmpty() ? nullptr : findFilterGroup(filter);
+    }
+    countBroadcastClient(client, 1);
+
+    // A client resuming where it left off only needs what changed since; anyone else, or one
+    // the replay buffer no longer reaches back for, starts over from a snapshot. Broadcasts
+    // already encoded for the old format or filter are superseded either way.
+    bool binary = client.protocol == StatusProtocol::Binary;
+    bool resumed = false;
+    uint64_t sequence;
+    std::string update;
+    {
+        EncodeLock lock(*this);
+        FilterGroup* group = client.filter.get();
+        std::vector<SensorId> missed;
+        if (resumeRequested && resumeStream == streamId && collectMissedChanges(resumeSequence, group, missed)) {
+            resumed = true;
+            if (!missed.empty()) update = binary ? generateBinaryDelta(missed) : generateDeltaMessage(missed);
+        } else {
+            uint64_t generation = refreshStates();
+            update = binary ? generateBinarySnapshot(group) : generateStatusMessage(generation, group);
+        }
+        sequence = broadcastSequence;
+        client.coveredSequence = sequence;
+        client.needsKeyframe = false;
+    }
+
+    // The acknowledgement is the last JSON line; a binary client switches framing after it,
+    // and a compressing client receives it in the mode it was in before this HELLO
+    std::string ack = std::string("{\"type\":\"hello\",\"protocol\":\"") + (binary ? "binary" : "json") + "\"";
+    ack += ",\"stream\":" + std::to_string(streamId) + ",\"seq\":" + std::to_string(sequence);
+    if (resumed) {
+        ack += ",\"resumed\":true";
+    }
+    if (compress) {
+        ack += ",\"compression\":\"deflate\"";
+    }
+    if (client.updateRate > 0) {
+        ack += ",\"rate\":" + std::to_string(client.updateRate);
+    }
+    if (client.filter) {
+        ack += ",\"filter\":\"";
+        StatusWriter::appendEscaped(ack, client.filter->key);
+        ack += "\"";
+    }
+    ack += "}\n";
+    if (!enqueueMessage(client, makeStatusFrame(ack), FrameKind::Control)) return false;
+    client.compressed = compress;
+
+    if (binary) {
+        client.knownSensorCount = 0;
+        if (!enqueueDictionary(client)) return false;
+    }
+
+    FrameKind updateKind = resumed ? FrameKind::Delta : FrameKind::Keyframe;
+    if (!update.empty() && !enqueueMessage(client, makeStatusFrame(std::move(update)), updateKind)) return false;
+    return flushClient(client);
+}
+
+// Full state for the client's protocol and filter, covering every broadcast so far
+std::string TCPServer::generateClientKeyframe(ClientConnection& client) {
+    EncodeLock lock(*this);
+    uint64_t generation = refreshStates();
+    client.coveredSequence = broadcastSequence;
+    FilterGroup* group = client.filter.get();
+    return client.protocol == StatusProtocol::Binary ? generateBinarySnapshot(group)
+                                                     : generateStatusMessage(generation, group);
+}
+
+bool TCPServer::enqueueMessage(ClientConnection& client, const StatusFramePtr& frame, FrameKind kind) {
+    if (kind != FrameKind::Control && client.outQueue.size() >= maxQueuedMessages) {
+        if (slowConsumerPolicy == SlowConsumerPolicy::Disconnect) {
+            std::cout << "Disconnecting slow client " << client.address << std::endl;
+            return false;
+        }
+
+        // A partially written message must complete or the stream would be corrupted, and
+        // frames handed to an io_uring send are already being written
+        auto first = client.outQueue.begin() + client.framesInFlight;
+        if (client.framesInFlight == 0 && client.sendOffset > 0) ++first;
+
+        // A keyframe supersedes everything queued before it. Once a delta is lost the client
+        // is wrong until its next keyframe, so the delta goes too and the client waits for
+        // the shared resync the primary encodes for every client in the same position.
+        auto kept = std::remove_if(first, client.outQueue.end(), [](const OutboundMessage& message) {
+            return message.kind != FrameKind::Control;
+        });
+        if (kept != client.outQueue.end()) {
+            client.outQueue.erase(kept, client.outQueue.end());
+            client.droppedMessages++;
+            Metrics::add(MetricCounter::FramesDropped);
+            if (kind == FrameKind::Delta) {
+                client.needsKeyframe = true;
+                requestResync();
+                return true;
+            }
+        }
+    }
+    if (kind == FrameKind::Keyframe) {
+        client.needsKeyframe = false;
+    }
+
+    if (client.compressed) {
+        StatusFramePtr compressed = FrameCompressor::compressed(frame);
+        if (!compressed) {
+            std::cerr << "Failed to compress frame for " << client.address << std::endl;
+            return false;
+        }
+        client.outQueue.push_back({compressed, kind});
+    } else {
+        client.outQueue.push_back({frame, kind});
+    }
+    Metrics::record(MetricHistogram::QueueDepth, client.outQueue.size());
+    return true;
+}
+
+bool TCPServer::enqueueDictionary(ClientConnection& client) {
+    {
+        std::shared_lock<std::shared_mutex> lock(sensorsMutex);
+        if (client.knownSensorCount == sensors.size()) return true;
+    }
+
+    size_t sensorCount = 0;
+    std::string dictionary;
+    {
+        EncodeLock lock(*this);
+        dictionary = generateBinaryDictionary(sensorCount, client.filter.get());
+    }
+    client.knownSensorCount = sensorCount;
+    return enqueueMessage(client, makeStatusFrame(std::move(dictionary)), FrameKind::Control);
+}
+
+bool TCPServer::flushClient(ClientConnection& client) {
+#ifdef URING_TRANSPORT_SUPPORTED
+    if (client.shard->uring.isOpen()) {
+        // The ring waits for writability itself, so readiness events are not needed
+        if (client.writeInterest) {
+            client.shard->reactor.modify(client.socket, Reactor::Readable);
+            client.writeInterest = false;
+        }
+        // One send per client at a time; its completion sends whatever queued up meanwhile
+        if (client.uringSend != 0 || client.outQueue.empty()) return true;
+        if (submitUringSend(client)) return true;
+        // The submission queue is unavailable, so this flush goes out through the socket
+    }
+#endif
+
+    while (!client.outQueue.empty()) {
+        // Gather queued frames into one vectored send instead of a syscall per frame
+        size_t frameCount = std::min(client.outQueue.size(), MAX_SEND_BATCH);
+        size_t totalBytes = 0;
 #ifdef _WIN32
-void TCPServer::removeDisconnectedClient(SOCKET clientSocket) {
+        WSABUF buffers[MAX_SEND_BATCH];
 #else
-void TCPServer::removeDisconnectedClient(int clientSocket) {
+        struct iovec buffers[MAX_SEND_BATCH];
 #endif
-    auto it = std::find(clientSockets.begin(), clientSockets.end(), clientSocket);
-    if (it != clientSockets.end()) {
-        clientSockets.erase(it);
+        for (size_t i = 0; i < frameCount; ++i) {
+            const StatusFrame& frame = *client.outQueue[i].frame;
+            size_t skip = i == 0 ? client.sendOffset : 0;
 #ifdef _WIN32
-        closesocket(clientSocket);
+            buffers[i].buf = (CHAR*)(frame.data() + skip);
+            buffers[i].len = (ULONG)(frame.size() - skip);
 #else
-        close(clientSocket);
+            buffers[i].iov_base = (void*)(frame.data() + skip);
+            buffers[i].iov_len = frame.size() - skip;
 #endif
+            totalBytes += frame.size() - skip;
+        }
+
+#ifdef _WIN32
+        DWORD bytesSent = 0;
+        long long result = WSASend(client.socket, buffers, (DWORD)frameCount, &bytesSent, 0, nullptr, nullptr) == 0
+                               ? (long long)bytesSent : -1;
+#else
+        struct msghdr msg = {};
+        msg.msg_iov = buffers;
+        msg.msg_iovlen = frameCount;
+        int flags = SEND_FLAGS;
+#ifdef TCP_SERVER_ZEROCOPY
+        bool zeroCopy = client.zeroCopyEnabled && totalBytes >= zeroCopyThreshold;
+        if (zeroCopy) flags |= MSG_ZEROCOPY;
+#endif
+        long long result = sendmsg(client.socket, &msg, flags);
+#endif
+        if (result < 0) {
+            if (socketInterrupted()) continue;
+            if (socketWouldBlock()) break;
+            std::cout << "Client disconnected" << std::endl;
+            return false;
+        }
+
+#ifdef TCP_SERVER_ZEROCOPY
+        size_t remaining = (size_t)result;
+        if (zeroCopy && remaining > 0) {
+            // The kernel numbers every successful MSG_ZEROCOPY send; keep its frames until reaped
+            ZeroCopySend pending;
+            pending.id = client.nextZeroCopyId++;
+            size_t covered = 0;
+            for (size_t i = 0; i < frameCount && covered < remaining; ++i) {
+                pending.frames.push_back(client.outQueue[i].frame);
+                covered += buffers[i].iov_len;
+            }
+            client.zeroCopyPending.push_back(std::move(pending));
+        }
+#endif
+
+        consumeSent(client, (size_t)result);
+
+        // A short write means the socket buffer is full; wait for a writable event
+        if ((size_t)result < totalBytes) break;
     }
+
+    updateWriteInterest(client);
+    return true;
 }
 
-std::string TCPServer::generateStatusMessage() const {
-    std::ostringstream oss;
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    
-    char time_buf[32];
-#ifdef _WIN32
-    ctime_s(time_buf, sizeof(time_buf), &time_t);
-    std::string timestamp(time_buf);
+// Drops the frames a send has fully written and advances into the next one
+void TCPServer::consumeSent(ClientConnection& client, size_t bytes) {
+    Metrics::add(MetricCounter::BytesSent, bytes);
+    while (bytes > 0) {
+        size_t frameRemaining = client.outQueue.front().frame->size() - client.sendOffset;
+        if (bytes < frameRemaining) {
+            client.sendOffset += bytes;
+            break;
+        }
+        bytes -= frameRemaining;
+        Metrics::record(MetricHistogram::SendLatencyNs, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - client.outQueue.front().frame->createdAt()).count());
+        client.outQueue.pop_front();
+        client.sendOffset = 0;
+        client.messagesSent++;
+    }
+}
+
+void TCPServer::reapZeroCopyCompletions(ClientConnection& client) {
+#ifdef TCP_SERVER_ZEROCOPY
+    char control[128];
+    while (true) {
+        struct msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(client.socket, &msg, MSG_ERRQUEUE) < 0) break;
+
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+
+            const struct sock_extended_err* err = (const struct sock_extended_err*)CMSG_DATA(cm);
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+            // Notification covers the inclusive id range [ee_info, ee_data]
+            uint32_t first = err->ee_info;
+            uint32_t last = err->ee_data;
+            auto& pending = client.zeroCopyPending;
+            pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                         [first, last](const ZeroCopySend& send) {
+                                             return send.id - first <= last - first;
+                                         }),
+                          pending.end());
+        }
+    }
 #else
-    std::string timestamp(std::ctime(&time_t));
+    (void)client;
 #endif
-    // Remove newline from ctime
-    if (!timestamp.empty() && timestamp.back() == '\n') {
-        timestamp.pop_back();
+}
+
+void TCPServer::updateWriteInterest(ClientConnection& client) {
+    // Only ask for writable events while there is a backlog, otherwise epoll spins
+    bool wantWrite = !client.outQueue.empty();
+    if (wantWrite != client.writeInterest) {
+        uint32_t events = Reactor::Readable;
+        if (wantWrite) events |= Reactor::Writable;
+        client.shard->reactor.modify(client.socket, events);
+        client.writeInterest = wantWrite;
     }
-    
-    oss << "{";
-    oss << "\"timestamp\":\"" << timestamp << "\",";
-    oss << "\"server_status\":\"running\",";
-    oss << "\"connected_clients\":" << getClientCount() << ",";
-    oss << "\"sensors\":[";
-    
-    for (size_t i = 0; i < sensors.size(); ++i) {
-        if (i > 0) oss << ",";
-        oss << "{";
-        oss << "\"name\":\"" << sensors[i].getName() << "\",";
-        oss << "\"location\":\"" << sensors[i].getLocation() << "\",";
-        oss << "\"state\":\"";
-        
-        switch (sensors[i].getCurrentState()) {
-            case SensorState::Off: oss << "Off"; break;
-            case SensorState::Initializing: oss << "Initializing"; break;
-            case SensorState::Operational: oss << "Operational"; break;
-            case SensorState::Declaring: oss << "Declaring"; break;
-            case SensorState::Degraded: oss << "Degraded"; break;
+}
+
+#ifdef URING_TRANSPORT_SUPPORTED
+// Moves a shard's accepts and sends onto an io_uring; false leaves it on the reactor
+bool TCPServer::openUring(IOShard& shard) {
+    if (!shard.uring.open(URING_ENTRIES, URING_BUFFER_SLOTS)) return false;
+    shard.registeredFrames.assign(shard.uring.bufferSlotCount(), RegisteredFrame());
+
+    // Connections arrive as completions instead of listener readiness
+    shard.reactor.remove(shard.listenSocket);
+    if (shard.reactor.add(shard.uring.fd(), Reactor::Readable) && armUringAccept(shard)) return true;
+
+    shard.reactor.remove(shard.uring.fd());
+    shard.uring.close();
+    shard.uringOps.clear();
+    shard.registeredFrames.clear();
+    shard.reactor.add(shard.listenSocket, Reactor::Readable);
+    return false;
+}
+
+bool TCPServer::armUringAccept(IOShard& shard) {
+    std::unique_ptr<UringOp> op(new UringOp());
+    op->accept = true;
+    uint64_t id = shard.nextUringOp++;
+    if (!shard.uring.prepareAccept(shard.listenSocket, shard.multishotAccept, id)) return false;
+    shard.uringOps.emplace(id, std::move(op));
+    return true;
+}
+
+// Queues the client's backlog as one send; it is submitted with the rest of the loop pass
+bool TCPServer::submitUringSend(ClientConnection& client) {
+    IOShard& shard = *client.shard;
+    std::unique_ptr<UringOp> op(new UringOp());
+    op->socket = client.socket;
+    op->connectionId = client.connectionId;
+    uint64_t id = shard.nextUringOp++;
+
+    const StatusFramePtr& head = client.outQueue.front().frame;
+    bool zeroCopy = zeroCopyThreshold > 0 && !shard.registeredFrames.empty();
+    int slot = zeroCopy && head->size() >= zeroCopyThreshold ? registeredFrameSlot(shard, head) : -1;
+    bool queued;
+    if (slot >= 0) {
+        // Large frames go out alone, straight from the registered copy every client shares
+        op->frames.push_back(head);
+        op->bufferSlot = slot;
+        queued = shard.uring.prepareSendFixed(client.socket, head->data() + client.sendOffset,
+                                              head->size() - client.sendOffset, (uint32_t)slot, id);
+    } else {
+        // Gathered like the socket path, except that a large frame waits for a send of its own
+        size_t frameCount = std::min(client.outQueue.size(), MAX_SEND_BATCH);
+        for (size_t i = 0; i < frameCount; ++i) {
+            const StatusFramePtr& frame = client.outQueue[i].frame;
+            if (i > 0 && zeroCopy && frame->size() >= zeroCopyThreshold) break;
+            size_t skip = i == 0 ? client.sendOffset : 0;
+            struct iovec buffer;
+            buffer.iov_base = (void*)(frame->data() + skip);
+            buffer.iov_len = frame->size() - skip;
+            op->buffers.push_back(buffer);
+            op->frames.push_back(frame);
         }
-        
-        oss << "\"";
-        oss << "}";
+        op->msg.msg_iov = op->buffers.data();
+        op->msg.msg_iovlen = op->buffers.size();
+        queued = shard.uring.prepareSendMsg(client.socket, &op->msg, id);
     }
-    
-    oss << "]";
-    oss << "}\n";
-    
-    return oss.str();
+    if (!queued) return false;
+
+    if (slot >= 0) shard.registeredFrames[slot].sends++;
+    client.uringSend = id;
+    client.framesInFlight = op->frames.size();
+    shard.uringOps.emplace(id, std::move(op));
+    return true;
+}
+
+// Slot holding this frame, registering it first if needed; -1 to send it by copy instead
+int TCPServer::registeredFrameSlot(IOShard& shard, const StatusFramePtr& frame) {
+    auto found = shard.registeredSlots.find(frame.get());
+    if (found != shard.registeredSlots.end()) {
+        shard.registeredFrames[found->second].lastUsed = ++shard.registrationClock;
+        return (int)found->second;
+    }
+
+    // Replace the least recently used frame that no send is reading from
+    int victim = -1;
+    for (size_t i = 0; i < shard.registeredFrames.size(); ++i) {
+        const RegisteredFrame& candidate = shard.registeredFrames[i];
+        if (candidate.sends == 0 && (victim < 0 || candidate.lastUsed < shard.registeredFrames[victim].lastUsed)) {
+            victim = (int)i;
+        }
+    }
+    if (victim < 0) return -1;
+
+    if (!shard.uring.registerBuffer((uint32_t)victim, frame->data(), frame->size())) {
+        // Typically RLIMIT_MEMLOCK; trying again for every client would cost a syscall each
+        std::cerr << "Failed to register frame buffer, sending large frames by copy" << std::endl;
+        shard.registeredFrames.clear();
+        shard.registeredSlots.clear();
+        return -1;
+    }
+    RegisteredFrame& slot = shard.registeredFrames[victim];
+    if (slot.frame) shard.registeredSlots.erase(slot.frame.get());
+    slot.frame = frame;
+    slot.lastUsed = ++shard.registrationClock;
+    shard.registeredSlots[frame.get()] = (uint32_t)victim;
+    return victim;
+}
+
+void TCPServer::handleUringCompletions(IOShard& shard) {
+    std::vector<SocketHandle> disconnectedClients;
+    UringTransport::Completion completion;
+    while (shard.uring.nextCompletion(completion)) {
+        // Cancellations carry user data 0
+        auto it = shard.uringOps.find(completion.userData);
+        if (it == shard.uringOps.end()) continue;
+        UringOp& op = *it->second;
+
+        if (op.accept) {
+            bool rearm = !completion.more;
+            if (completion.result >= 0) {
+                SocketHandle clientSocket = (SocketHandle)completion.result;
+                struct sockaddr_in clientAddr;
+                socklen_t clientAddrLen = sizeof(clientAddr);
+                memset(&clientAddr, 0, sizeof(clientAddr));
+                getpeername(clientSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
+                addClient(shard, clientSocket, clientAddr);
+            } else if (completion.result == -EINVAL && shard.multishotAccept) {
+                // Kernels before 5.19 take one connection per accept request
+                shard.multishotAccept = false;
+            } else if (completion.result == -EINVAL) {
+                rearm = false;
+                std::cerr << "io_uring accept failed, accepting through the event loop" << std::endl;
+                shard.reactor.add(shard.listenSocket, Reactor::Readable);
+            } else if (completion.result != -ECONNABORTED && completion.result != -EINTR &&
+                       completion.result != -EAGAIN && completion.result != -ECANCELED) {
+                std::cerr << "Failed to accept client connection" << std::endl;
+            }
+
+            if (!completion.more) {
+                shard.uringOps.erase(completion.userData);
+                if (rearm && isRunning && !armUringAccept(shard)) {
+                    shard.reactor.add(shard.listenSocket, Reactor::Readable);
+                }
+            }
+            continue;
+        }
+
+        if (!completion.notification) {
+            // A connection closed meanwhile, or a newer one on the same socket, is not affected
+            auto client = shard.clients.find(op.socket);
+            if (client != shard.clients.end() && client->second.connectionId == op.connectionId) {
+                client->second.uringSend = 0;
+                client->second.framesInFlight = 0;
+                if (!completeUringSend(client->second, completion.result)) {
+                    disconnectedClients.push_back(op.socket);
+                }
+            }
+            // A zero-copy send still owns its frame until the notification
+            if (completion.more) continue;
+        }
+
+        if (op.bufferSlot >= 0 && (size_t)op.bufferSlot < shard.registeredFrames.size()) {
+            shard.registeredFrames[op.bufferSlot].sends--;
+        }
+        shard.uringOps.erase(completion.userData);
+    }
+
+    for (SocketHandle disconnectedSocket : disconnectedClients) {
+        removeDisconnectedClient(shard, disconnectedSocket);
+    }
+}
+
+bool TCPServer::completeUringSend(ClientConnection& client, int32_t result) {
+    if (result == -EAGAIN || result == -EINTR) {
+        // Not retried inside the ring on this kernel; wait for writability the usual way
+        client.shard->reactor.modify(client.socket, Reactor::Readable | Reactor::Writable);
+        client.writeInterest = true;
+        return true;
+    }
+    if (result < 0) {
+        std::cout << "Client disconnected" << std::endl;
+        return false;
+    }
+
+    consumeSent(client, (size_t)result);
+    return flushClient(client);
+}
+#endif
+
+void TCPServer::removeDisconnectedClient(IOShard& shard, SocketHandle clientSocket) {
+    auto it = shard.clients.find(clientSocket);
+    if (it != shard.clients.end()) {
+#ifdef URING_TRANSPORT_SUPPORTED
+        // Completes as cancelled; the frames it reads stay alive until then
+        if (it->second.uringSend != 0) shard.uring.prepareCancel(it->second.uringSend);
+#endif
+        countBroadcastClient(it->second, -1);
+        shard.reactor.remove(clientSocket);
+        closeSocketHandle(clientSocket);
+        shard.clients.erase(it);
+        clientCount--;
+        Metrics::add(MetricCounter::ClientDisconnects);
+    }
+}
+
+// Returns the shared group for this filter, creating it for the first client that uses it
+TCPServer::FilterGroupPtr TCPServer::findFilterGroup(const SubscriptionFilter& filter) {
+    std::string key = filter.key();
+    std::lock_guard<std::mutex> lock(encodeMutex);
+    FilterGroupPtr group = filterGroups[key].lock();
+    if (!group) {
+        group = std::make_shared<FilterGroup>();
+        group->filter = filter;
+        group->key = key;
+        filterGroups[key] = group;
+    }
+    return group;
+}
+
+// Groups that have broadcast clients; groups whose last client left are dropped here
+std::vector<TCPServer::FilterGroupPtr> TCPServer::broadcastFilterGroups() {
+    std::vector<FilterGroupPtr> groups;
+    for (auto it = filterGroups.begin(); it != filterGroups.end();) {
+        FilterGroupPtr group = it->second.lock();
+        if (!group) {
+            it = filterGroups.erase(it);
+            continue;
+        }
+        if (group->broadcastClients[0] > 0 || group->broadcastClients[1] > 0) {
+            groups.push_back(std::move(group));
+        }
+        ++it;
+    }
+    return groups;
 }
 
-void TCPServer::addSensor(const Sensor& sensor) {
-    sensors.push_back(sensor);
+// Name and location never change, so each sensor is matched once per group
+void TCPServer::updateSensorMatches(FilterGroup& group) {
+    for (SensorId id = (SensorId)group.sensorMatches.size(); id < sensors.size(); ++id) {
+        group.sensorMatches.push_back(group.filter.matchesSensor(sensors.getName(id), sensors.getLocation(id)));
+    }
+}
+
+void TCPServer::selectSensors(FilterGroup& group, bool byState, std::vector<SensorId>& selected) {
+    updateSensorMatches(group);
+    const uint8_t* states = sensors.stateData();
+    selected.clear();
+    for (SensorId id = 0; id < sensors.size(); ++id) {
+        if (group.sensorMatches[id] && (!byState || group.filter.matchesState(states[id]))) {
+            selected.push_back(id);
+        }
+    }
+}
+
+// Sensors changed by broadcasts after sequence that the filter shows now or showed as of
+// sequence, with fresh states. Fails when the replay buffer no longer reaches back that far.
+bool TCPServer::collectMissedChanges(uint64_t sequence, FilterGroup* filter, std::vector<SensorId>& missed) {
+    std::vector<uint8_t> previous;
+    if (!replay.collect(sequence, broadcastSequence, missed, previous)) return false;
+    refreshStates(missed);
+    if (!filter) return true;
+
+    updateSensorMatches(*filter);
+    const uint8_t* states = sensors.stateData();
+    size_t kept = 0;
+    for (size_t i = 0; i < missed.size(); ++i) {
+        SensorId id = missed[i];
+        if (filter->sensorMatches[id] &&
+            (filter->filter.matchesState(states[id]) || filter->filter.matchesState(previous[i]))) {
+            missed[kept++] = id;
+        }
+    }
+    missed.resize(kept);
+    return true;
+}
+
+// Runs on the primary shard, the journal's only appender; storing records never waits on disk
+void TCPServer::journalChanges(const std::vector<SensorId>& changed, const uint8_t* previous) {
+    if (!journal.isOpen()) return;
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    const uint8_t* states = sensors.stateData();
+    for (size_t i = 0; i < changed.size(); ++i) {
+        journal.append(now, changed[i], previous[i], states[changed[i]]);
+    }
+}
+
+// Sensors no broadcast has covered yet: the registry still holds what clients were last sent
+void TCPServer::seedBroadcastStates() {
+    const uint8_t* states = sensors.stateData();
+    if (broadcastStates.size() < sensors.size()) {
+        broadcastStates.insert(broadcastStates.end(), states + broadcastStates.size(), states + sensors.size());
+    }
+}
+
+// Copies a consistent snapshot of liveStates into the registry for the encoders
+uint64_t TCPServer::refreshStates() {
+    return liveStates.read(sensors.stateData(), sensors.size());
+}
+
+// Deltas only need the sensors that changed, read once so every encoding agrees
+void TCPServer::refreshStates(const std::vector<SensorId>& changed) {
+    uint8_t* states = sensors.stateData();
+    for (SensorId id : changed) {
+        states[id] = (uint8_t)liveStates.get(id);
+    }
+}
+
+// Every frame is stamped with broadcastSequence: the broadcast a delta belongs to, or the
+// last broadcast a snapshot already reflects
+std::string TCPServer::generateStatusMessage(uint64_t generation, FilterGroup* filter) {
+    auto start = std::chrono::steady_clock::now();
+    std::string message;
+    if (!filter) {
+        message = statusWriter.writeSnapshot(sensors, generation, broadcastSequence, getClientCount());
+    } else {
+        std::vector<SensorId> selected;
+        selectSensors(*filter, true, selected);
+        message = statusWriter.writeSnapshot(sensors, generation, broadcastSequence, getClientCount(), &selected);
+    }
+    recordFrameBuilt(start);
+    return message;
+}
+
+std::string TCPServer::generateDeltaMessage(const std::vector<SensorId>& changed) {
+    Metrics::add(MetricCounter::FramesBuilt);
+    return statusWriter.writeDelta(sensors, broadcastSequence, changed);
+}
+
+std::string TCPServer::generateBinarySnapshot(FilterGroup* filter) {
+    auto start = std::chrono::steady_clock::now();
+    std::string message;
+    if (!filter) {
+        message = BinaryProtocol::encodeSnapshot(sensors, currentTimeMs(), broadcastSequence);
+    } else {
+        std::vector<SensorId> selected;
+        selectSensors(*filter, true, selected);
+        message = BinaryProtocol::encodeSparseSnapshot(sensors, selected, currentTimeMs(), broadcastSequence);
+    }
+    recordFrameBuilt(start);
+    return message;
+}
+
+std::string TCPServer::generateBinaryDelta(const std::vector<SensorId>& changed) {
+    Metrics::add(MetricCounter::FramesBuilt);
+    return BinaryProtocol::encodeDelta(sensors, changed, currentTimeMs(), broadcastSequence);
+}
+
+std::string TCPServer::generateBinaryDictionary(size_t& sensorCount, FilterGroup* filter) {
+    Metrics::add(MetricCounter::FramesBuilt);
+    sensorCount = sensors.size();
+    if (!filter) return BinaryProtocol::encodeDictionary(sensors);
+
+    // Every sensor the filter could ever show, whatever its state right now
+    std::vector<SensorId> selected;
+    selectSensors(*filter, false, selected);
+    return BinaryProtocol::encodeDictionary(sensors, &selected);
+}
+
+// Snapshots are the expensive frames, so their build time is tracked separately
+void TCPServer::recordFrameBuilt(std::chrono::steady_clock::time_point start) {
+    Metrics::add(MetricCounter::FramesBuilt);
+    Metrics::record(MetricHistogram::SnapshotBuildNs, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+SensorId TCPServer::addSensor(const Sensor& sensor) {
+    std::unique_lock<std::shared_mutex> lock(sensorsMutex);
+    size_t count = sensors.size();
+    SensorId id = sensors.find(sensor.getName());
+    if (id != INVALID_SENSOR_ID) return id;
+    if (count >= SensorStateTable::MAX_SENSORS) return INVALID_SENSOR_ID;
+
+    {
+        // Before the table publishes the new ID, which a producer may then set immediately
+        std::lock_guard<std::mutex> changesLock(changesMutex);
+        changePending.push_back(false);
+        pendingTransitions.push_back(0);
+    }
+    id = sensors.add(sensor);
+    liveStates.append(sensor.getCurrentState());
+    journal.recordSensor(id, sensor.getName(), sensor.getLocation());
+    return id;
+}
+
+SensorId TCPServer::findSensor(const std::string& name) const {
+    std::shared_lock<std::shared_mutex> lock(sensorsMutex);
+    return sensors.find(name);
+}
+
+size_t TCPServer::getSensorCount() const {
+    return liveStates.size();
+}
+
+bool TCPServer::setSensorState(SensorId id, SensorState state) {
+    if (!isValidSensorState((uint8_t)state)) return false;
+
+    SensorState previous;
+    if (!liveStates.set(id, state, previous)) return false;
+    if (previous != state) queueChanges(&id, 1);
+    return true;
+}
+
+bool TCPServer::setSensorState(const std::string& name, SensorState state) {
+    return setSensorState(findSensor(name), state);
+}
+
+size_t TCPServer::setSensorStates(const SensorId* ids, const uint8_t* states, size_t count) {
+    std::vector<SensorId> changed;
+    return applySensorStates(ids, states, count, nullptr, changed);
+}
+
+size_t TCPServer::setSensorStates(const SensorId* ids, const uint8_t* states, size_t count,
+                                  std::chrono::steady_clock::time_point receivedAt, std::vector<SensorId>& changed) {
+    return applySensorStates(ids, states, count, &receivedAt, changed);
+}
+
+size_t TCPServer::applySensorStates(const SensorId* ids, const uint8_t* states, size_t count,
+                                    const std::chrono::steady_clock::time_point* receivedAt,
+                                    std::vector<SensorId>& changed) {
+    changed.clear();
+    size_t applied = liveStates.setMany(ids, states, count, changed);
+    if (!changed.empty()) queueChanges(changed.data(), changed.size(), receivedAt);
+    return applied;
+}
+
+size_t TCPServer::copySensorStates(uint8_t* out, size_t capacity, uint64_t& generation) {
+    size_t total = liveStates.size();
+    generation = liveStates.read(out, std::min(capacity, total));
+    return total;
+}
+
+// Records changed sensors for the next delta and wakes the primary shard to send it
+void TCPServer::queueChanges(const SensorId* ids, size_t count,
+                             const std::chrono::steady_clock::time_point* receivedAt) {
+    std::lock_guard<std::mutex> lock(changesMutex);
+    if (receivedAt && !hasPendingIngest) {
+        hasPendingIngest = true;
+        pendingIngestAt = *receivedAt;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        pendingTransitions[ids[i]]++;
+        if (!changePending[ids[i]]) {
+            changePending[ids[i]] = true;
+            pendingChanges.push_back(ids[i]);
+        }
+    }
+
+    // Only the first change of a batch needs a wakeup; the rest ride along with it.
+    // changesMutex also keeps the shard list stable while start and stop replace it.
+    bool wasPending = hasPendingChanges.exchange(true);
+    if (!wasPending && isRunning && !shards.empty()) {
+        shards[0]->reactor.wakeup();
+    }
+}
+
+bool TCPServer::enableSharedSnapshots(const std::string& name, size_t maxSensors, uint32_t slotCount) {
+    return sharedSnapshots.create(name, (uint32_t)std::min(maxSensors, SensorStateTable::MAX_SENSORS), slotCount);
+}
+
+bool TCPServer::enableJournal(const std::string& directory, size_t segmentBytes, size_t maxSegments,
+                              std::chrono::milliseconds commitInterval) {
+    if (!journal.open(directory, segmentBytes, maxSegments, commitInterval)) return false;
+
+    // Sensors added from now on are named by addSensor()
+    std::shared_lock<std::shared_mutex> lock(sensorsMutex);
+    for (SensorId id = 0; id < sensors.size(); ++id) {
+        journal.recordSensor(id, sensors.getName(id), sensors.getLocation(id));
+    }
+    return true;
 }
 
 bool TCPServer::hasClients() const {
-    std::lock_guard<std::mutex> lock(clientsMutex);
-    return !clientSockets.empty();
+    return clientCount > 0;
 }
 
 size_t TCPServer::getClientCount() const {
-    std::lock_guard<std::mutex> lock(clientsMutex);
-    return clientSockets.size();
-}
\ No newline at end of file
+    return clientCount;
+}
+
+std::vector<ClientStats> TCPServer::getClientStats() const {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    std::vector<ClientStats> stats;
+    for (const std::vector<ClientStats>& shardStats : publishedStats) {
+        stats.insert(stats.end(), shardStats.begin(), shardStats.end());
+    }
+    return stats;
+}
+
+void TCPServer::setIOThreads(size_t count) {
+    ioThreadCount = std::max<size_t>(1, count);
+}
+
+void TCPServer::setListenBacklog(int backlog) {
+    listenBacklog = std::max(1, backlog);
+}
+
+void TCPServer::setIOBackend(IOBackend backend) {
+    ioBackend = backend;
+}
+
+void TCPServer::setMaxQueuedMessages(size_t maxMessages) {
+    maxQueuedMessages = std::max<size_t>(1, maxMessages);
+}
+
+void TCPServer::setSlowConsumerPolicy(SlowConsumerPolicy policy) {
+    slowConsumerPolicy = policy;
+}
+
+void TCPServer::setKeyframeInterval(std::chrono::milliseconds interval) {
+    keyframeInterval = std::max(interval, std::chrono::milliseconds(1));
+}
+
+void TCPServer::setReplayCapacity(size_t broadcasts) {
+    std::lock_guard<std::mutex> lock(encodeMutex);
+    replay.setCapacity(broadcasts);
+}
+
+void TCPServer::setCoalescingWindow(std::chrono::milliseconds window) {
+    damper.setWindow(window);
+}
+
+void TCPServer::setFlapDamping(std::chrono::milliseconds halfLife, double suppressAt, double reuseBelow,
+                               std::chrono::milliseconds maxSuppress) {
+    damper.setFlapDamping(halfLife, suppressAt, reuseBelow, maxSuppress);
+}
+
+void TCPServer::setZeroCopyThreshold(size_t bytes) {
+    zeroCopyThreshold = bytes;
+}
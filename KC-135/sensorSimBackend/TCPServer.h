@@ -3,61 +3,369 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
 #include <atomic>
 #include <chrono>
+#include "ChangeDamper.h"
 #include "Sensor.h"
+#include "SensorRegistry.h"
+#include "SensorStateTable.h"
+#include "SharedSnapshotWriter.h"
+#include "JournalWriter.h"
+#include "Reactor.h"
+#include "ReplayBuffer.h"
+#include "SocketCompat.h"
+#include "StatusFrame.h"
+#include "StatusWriter.h"
+#include "SubscriptionFilter.h"
+#include "TimerWheel.h"
+#include "UringTransport.h"
 
-#ifdef _WIN32
-    #define WIN32_LEAN_AND_MEAN
-    #include <windows.h>
-    #include <winsock2.h>
-    #include <ws2tcpip.h>
-#else
-    #include <sys/socket.h>
-    #include <netinet/in.h>
-    #include <arpa/inet.h>
-    #include <unistd.h>
-#endif
+// What to do with a client whose outbound queue is full because it stopped reading
+enum class SlowConsumerPolicy {
+    DropOldest,   // Discard queued frames not yet transmitting; a client that loses a delta is
+                  // sent no more deltas until a shared resync keyframe reaches it
+    Disconnect    // Close the connection
+};
+
+// Encoding of the status stream; clients opt into Binary with "HELLO protocol=binary\n"
+enum class StatusProtocol {
+    Json,
+    Binary
+};
+
+// How the IO threads accept and send
+enum class IOBackend {
+    Sockets,   // Readiness events and a send per client
+    IoUring    // Sends and accepts batched through an io_uring per IO thread (Linux); falls
+               // back to Sockets where the kernel or build does not allow it
+};
+
+// Per-connection figures published by the IO threads about once per second
+struct ClientStats {
+    std::string address;
+    StatusProtocol protocol;
+    double requestedRate;   // Snapshots per second asked for with "rate=", 0 for event-driven
+    double achievedRate;    // Snapshots per second actually queued over the last window
+    uint64_t messagesSent;
+    uint64_t droppedMessages;
+    size_t queuedMessages;
+};
 
 class TCPServer {
 private:
-#ifdef _WIN32
-    SOCKET serverSocket;
-#else
-    int serverSocket;
+    // What a queued frame is, which decides what a full queue may discard
+    enum class FrameKind : uint8_t {
+        Control,    // Handshake and dictionary frames, never dropped
+        Keyframe,   // Full state, superseded by any later keyframe
+        Delta       // Only meaningful after every earlier frame
+    };
+
+    struct OutboundMessage {
+        StatusFramePtr frame;
+        FrameKind kind;
+    };
+
+    // Frames handed to the kernel with MSG_ZEROCOPY stay alive until it reports completion
+    struct ZeroCopySend {
+        uint32_t id;
+        std::vector<StatusFramePtr> frames;
+    };
+
+    // Clients with equal subscription filters share one group, and one set of frames per broadcast
+    struct FilterGroup {
+        SubscriptionFilter filter;
+        std::string key;
+        std::vector<uint8_t> sensorMatches;       // Per sensor: passes name/location; encodeMutex
+        std::atomic<size_t> broadcastClients[2];  // Clients without a rate, per StatusProtocol
+
+        FilterGroup() { broadcastClients[0] = 0; broadcastClients[1] = 0; }
+    };
+    typedef std::shared_ptr<FilterGroup> FilterGroupPtr;
+
+#ifdef URING_TRANSPORT_SUPPORTED
+    // A send or accept handed to a shard's io_uring, alive until its last completion
+    struct UringOp {
+        bool accept = false;
+        SocketHandle socket = INVALID_SOCKET_HANDLE;
+        uint64_t connectionId = 0;
+        std::vector<StatusFramePtr> frames;  // Read by the kernel until the send completes
+        int bufferSlot = -1;                 // Registered buffer a zero-copy send reads from
+        struct msghdr msg = {};
+        std::vector<struct iovec> buffers;
+    };
+
+    // Frames are registered once per shard and shared by every client's zero-copy send
+    struct RegisteredFrame {
+        StatusFramePtr frame;
+        size_t sends = 0;       // In flight; the slot is only reused at 0
+        uint64_t lastUsed = 0;
+    };
 #endif
-    int port;
-#ifdef _WIN32
-    std::vector<SOCKET> clientSockets;
-#else
-    std::vector<int> clientSockets;
+
+    struct IOShard;
+
+    struct ClientConnection {
+        SocketHandle socket;
+        IOShard* shard = nullptr;    // IO thread that owns this connection
+        uint64_t connectionId = 0;   // Tells a reused socket handle from the connection it replaced
+        std::string address;
+        std::deque<OutboundMessage> outQueue;
+        size_t sendOffset = 0;       // Bytes of outQueue.front() already written
+        bool writeInterest = false;  // Registered for writable notifications
+        uint64_t droppedMessages = 0;
+        std::string inBuffer;        // Partial command line received from the client
+        StatusProtocol protocol = StatusProtocol::Json;
+        bool compressed = false;     // Frames after the hello ack are deflated, see FrameCompressor
+        FilterGroupPtr filter;       // Null receives every sensor
+        size_t knownSensorCount = 0; // Sensors covered by the last dictionary sent
+        bool zeroCopyEnabled = false;
+        uint32_t nextZeroCopyId = 0;
+        std::deque<ZeroCopySend> zeroCopyPending;
+        uint64_t uringSend = 0;      // io_uring send in flight, 0 if none
+        size_t framesInFlight = 0;   // Leading outQueue frames that send covers
+        uint64_t messagesSent = 0;
+
+        // Periodic snapshot subscription; updateRate 0 means deltas as they happen
+        double updateRate = 0;
+        std::chrono::nanoseconds updatePeriod{0};
+        TimerWheel::Clock::time_point nextUpdate;
+        uint64_t updateTimerCookie = 0;  // Only the timer carrying this cookie is live
+        uint64_t updatesSent = 0;
+        uint64_t updatesAtLastStats = 0;
+        double achievedRate = 0;
+
+        // Broadcasts up to this sequence predate the last snapshot the client was sent
+        uint64_t coveredSequence = 0;
+        bool needsKeyframe = false;  // Dropped a delta; skips deltas until a keyframe is queued
+        bool awaitingHello = false;  // Connected but not sent anything yet, see HELLO_WAIT
+    };
+
+    struct FilteredFrames {
+        FilterGroupPtr group;
+        StatusFramePtr json;    // Null when nothing in the broadcast passes the filter
+        StatusFramePtr binary;
+    };
+
+    // A delta or keyframe encoded once by the primary shard for every shard's clients
+    struct BroadcastFrames {
+        StatusFramePtr json;
+        StatusFramePtr binary;
+        std::vector<FilteredFrames> filtered;
+        uint64_t sequence;
+        bool keyframe = false;
+        bool resync = false;    // Keyframe only for clients with needsKeyframe
+    };
+
+    // Everything the encoders read: encodeMutex, then sensorsMutex shared
+    struct EncodeLock {
+        std::lock_guard<std::mutex> encode;
+        std::shared_lock<std::shared_mutex> sensors;
+        explicit EncodeLock(TCPServer& server) : encode(server.encodeMutex), sensors(server.sensorsMutex) {}
+    };
+
+    // One listening socket, event loop and client set per IO thread. With several shards
+    // each listener binds the port with SO_REUSEPORT and the kernel spreads new connections
+    // across them. Shard 0 is the primary: it also collects state changes, encodes the
+    // broadcast frames and hands them to the other shards.
+    struct IOShard {
+        size_t index = 0;
+        SocketHandle listenSocket = INVALID_SOCKET_HANDLE;
+        Reactor reactor;
+        std::unordered_map<SocketHandle, ClientConnection> clients;  // Owned by this shard's thread
+        std::thread thread;
+        TimerWheel updateTimers;                 // Per-client snapshot deadlines
+        uint64_t nextTimerCookie = 1;
+        TimerWheel::Clock::time_point lastStatsTime;
+        uint64_t nextConnectionId = 1;
+
+#ifdef URING_TRANSPORT_SUPPORTED
+        UringTransport uring;                 // Open when this shard uses IOBackend::IoUring
+        std::unordered_map<uint64_t, std::unique_ptr<UringOp>> uringOps;  // By user data
+        uint64_t nextUringOp = 1;
+        bool multishotAccept = true;
+        std::vector<RegisteredFrame> registeredFrames;  // By buffer slot
+        std::unordered_map<const StatusFrame*, uint32_t> registeredSlots;
+        uint64_t registrationClock = 0;
 #endif
-    mutable std::mutex clientsMutex;
-    std::thread serverThread;
-    std::thread statusThread;
+
+        std::mutex inboxMutex;
+        std::vector<BroadcastFrames> inbox;      // Posted by the primary, drained by this shard
+        std::atomic<bool> hasInbox{false};
+    };
+
+    int port;
+    size_t ioThreadCount;
+    int listenBacklog;
+    IOBackend ioBackend;
+    std::vector<std::unique_ptr<IOShard>> shards;  // Replaced under changesMutex by start and stop
+    std::atomic<size_t> clientCount;
+    std::atomic<size_t> broadcastClients[2];  // Clients without a rate, per StatusProtocol
     std::atomic<bool> isRunning;
-    std::vector<Sensor> sensors;
-    
-    void acceptClients();
-    void sendStatusMessages();
-#ifdef _WIN32
-    void removeDisconnectedClient(SOCKET clientSocket);
-#else
-    void removeDisconnectedClient(int clientSocket);
+
+    // Names and locations. addSensor() takes sensorsMutex exclusively; lookups and the IO
+    // threads share it. The registry's state bytes are the encoders' copy of liveStates,
+    // refreshed under encodeMutex before each encode, so producers never touch them.
+    SensorRegistry sensors;
+    mutable std::shared_mutex sensorsMutex;
+    SensorStateTable liveStates;          // Written by producers without waiting on the IO threads
+    std::mutex encodeMutex;               // Registry state bytes and everything down to filterGroups
+    StatusWriter statusWriter;
+    uint64_t streamId;                    // Identifies this server's sequence numbers to resuming clients
+    uint64_t broadcastSequence;           // Stamped on every frame, see BinaryProtocol.h
+    std::vector<uint8_t> broadcastStates; // States as of the last broadcast, for state-filtered deltas
+    ReplayBuffer replay;                  // Recent broadcasts, for "HELLO resume="
+    std::unordered_map<std::string, std::weak_ptr<FilterGroup>> filterGroups;
+    SharedSnapshotWriter sharedSnapshots; // Published by the primary shard when enabled
+    JournalWriter journal;                // Appended to by the primary shard when enabled
+
+    // Sensors changed since the last delta; the primary holds changesMutex only to swap the list
+    std::mutex changesMutex;
+    std::vector<SensorId> pendingChanges;
+    std::vector<bool> changePending;
+    std::vector<uint32_t> pendingTransitions;  // Per sensor: state changes since it was queued
+    bool hasPendingIngest;                // Pending changes include external updates, the oldest
+    std::chrono::steady_clock::time_point pendingIngestAt;  // received at this time
+    ChangeDamper damper;                  // Primary shard only
+    std::atomic<bool> hasPendingChanges;
+    std::atomic<bool> resyncRequested;    // Some client dropped a delta, see broadcastResync()
+
+    size_t maxQueuedMessages;
+    SlowConsumerPolicy slowConsumerPolicy;
+    std::chrono::milliseconds keyframeInterval;
+    size_t zeroCopyThreshold;
+
+    std::vector<std::vector<ClientStats>> publishedStats;  // One list per shard
+    mutable std::mutex statsMutex;
+
+    bool openListener(IOShard& shard);
+    void closeShard(IOShard& shard);
+    void runEventLoop(IOShard& shard);
+    void acceptClients(IOShard& shard);
+    void addClient(IOShard& shard, SocketHandle clientSocket, const struct sockaddr_in& clientAddr);
+    bool sendInitialSnapshot(ClientConnection& client);
+    void broadcastStatus(IOShard& primary);
+    void broadcastChanges(IOShard& primary);
+    void broadcastResync(IOShard& primary);
+    void encodeKeyframes(BroadcastFrames& frames, uint64_t generation);
+    void requestResync();
+    void postBroadcast(IOShard& primary, const BroadcastFrames& frames);
+    void deliverBroadcasts(IOShard& shard);
+    void sendPeriodicUpdates(IOShard& shard, TimerWheel::Clock::time_point now);
+    void scheduleUpdates(ClientConnection& client, double rate);
+    void publishClientStats(IOShard& shard, TimerWheel::Clock::time_point now);
+    void countBroadcastClient(const ClientConnection& client, int delta);
+    bool anyClientUses(StatusProtocol protocol) const;
+    void broadcastMessage(IOShard& shard, const BroadcastFrames& frames);
+    void handleReadable(ClientConnection& client);
+    bool handleCommand(ClientConnection& client, const std::string& line);
+    bool enqueueMessage(ClientConnection& client, const StatusFramePtr& frame, FrameKind kind);
+    std::string generateClientKeyframe(ClientConnection& client);
+    bool enqueueDictionary(ClientConnection& client);
+    bool flushClient(ClientConnection& client);
+    void consumeSent(ClientConnection& client, size_t bytes);
+    void reapZeroCopyCompletions(ClientConnection& client);
+    void updateWriteInterest(ClientConnection& client);
+    void removeDisconnectedClient(IOShard& shard, SocketHandle clientSocket);
+    void queueChanges(const SensorId* ids, size_t count, const std::chrono::steady_clock::time_point* receivedAt = nullptr);
+    size_t applySensorStates(const SensorId* ids, const uint8_t* states, size_t count,
+                             const std::chrono::steady_clock::time_point* receivedAt, std::vector<SensorId>& changed);
+    FilterGroupPtr findFilterGroup(const SubscriptionFilter& filter);
+#ifdef URING_TRANSPORT_SUPPORTED
+    bool openUring(IOShard& shard);
+    bool armUringAccept(IOShard& shard);
+    bool submitUringSend(ClientConnection& client);
+    int registeredFrameSlot(IOShard& shard, const StatusFramePtr& frame);
+    void handleUringCompletions(IOShard& shard);
+    bool completeUringSend(ClientConnection& client, int32_t result);
 #endif
-    std::string generateStatusMessage() const;
+
+    // The functions below require an EncodeLock
+    std::vector<FilterGroupPtr> broadcastFilterGroups();
+    void updateSensorMatches(FilterGroup& group);
+    void selectSensors(FilterGroup& group, bool byState, std::vector<SensorId>& selected);
+    bool collectMissedChanges(uint64_t sequence, FilterGroup* filter, std::vector<SensorId>& missed);
+    void journalChanges(const std::vector<SensorId>& changed, const uint8_t* previous);
+    void seedBroadcastStates();
+    uint64_t refreshStates();
+    void refreshStates(const std::vector<SensorId>& changed);
+    std::string generateStatusMessage(uint64_t generation, FilterGroup* filter = nullptr);
+    std::string generateDeltaMessage(const std::vector<SensorId>& changed);
+    std::string generateBinarySnapshot(FilterGroup* filter = nullptr);
+    std::string generateBinaryDelta(const std::vector<SensorId>& changed);
+    std::string generateBinaryDictionary(size_t& sensorCount, FilterGroup* filter = nullptr);
+    void recordFrameBuilt(std::chrono::steady_clock::time_point start);
 
 public:
     TCPServer(int port);
     ~TCPServer();
-    
+
     bool startServer();
     void stopServer();
-    void addSensor(const Sensor& sensor);
+    // Returns the sensor's stable ID; a name that is already registered returns the existing ID
+    SensorId addSensor(const Sensor& sensor);
+    SensorId findSensor(const std::string& name) const;
+
+    size_t getSensorCount() const;
+
+    // Update a sensor and push the change to clients immediately. Safe to call from any
+    // thread while the server is broadcasting; a writer never waits for a snapshot to be
+    // encoded. Returns false for an unknown sensor or state.
+    bool setSensorState(SensorId id, SensorState state);
+    bool setSensorState(const std::string& name, SensorState state);
+    // Applies a batch as one update, so snapshots see all of it or none of it. states holds
+    // SensorState values; unknown IDs and invalid states are skipped. Returns the number applied.
+    size_t setSensorStates(const SensorId* ids, const uint8_t* states, size_t count);
+    // Same, for updates that arrived from outside at receivedAt; the time until the delta
+    // carrying them is posted is recorded as ingest_to_broadcast_ns. changed is scratch space
+    // the caller keeps from call to call, so a steady stream of updates does not allocate.
+    size_t setSensorStates(const SensorId* ids, const uint8_t* states, size_t count,
+                           std::chrono::steady_clock::time_point receivedAt, std::vector<SensorId>& changed);
+    // Copies up to capacity states, indexed by ID, as one consistent snapshot and returns
+    // the total sensor count, which may exceed capacity
+    size_t copySensorStates(uint8_t* out, size_t capacity, uint64_t& generation);
     bool hasClients() const;
     size_t getClientCount() const;
+    std::vector<ClientStats> getClientStats() const;
+
+    // Must be configured before startServer()
+    // IO threads, each with its own SO_REUSEPORT listener and clients; 1 where unsupported
+    void setIOThreads(size_t count);
+    void setListenBacklog(int backlog);
+    void setIOBackend(IOBackend backend);
+    void setMaxQueuedMessages(size_t maxMessages);
+    void setSlowConsumerPolicy(SlowConsumerPolicy policy);
+    // Period of full snapshots; changes in between are sent as deltas
+    void setKeyframeInterval(std::chrono::milliseconds interval);
+    // A sensor's changes within this window of its last broadcast are sent once, when the window
+    // ends, with its latest state; 0 sends every change at once
+    void setCoalescingWindow(std::chrono::milliseconds window);
+    // Holds back sensors that keep changing state until they settle, see ChangeDamper: each change
+    // adds 1 to a penalty halving every halfLife, and a sensor is suppressed from suppressAt until
+    // the penalty falls below reuseBelow, for at most maxSuppress. A halfLife of 0 disables it.
+    void setFlapDamping(std::chrono::milliseconds halfLife, double suppressAt = 4, double reuseBelow = 2,
+                        std::chrono::milliseconds maxSuppress = std::chrono::seconds(60));
+    // Batches of at least this many bytes are sent with MSG_ZEROCOPY where supported; 0 disables.
+    // With IOBackend::IoUring, frames this large are instead registered with the ring once and
+    // every client's copy is a zero-copy send from that registered buffer.
+    void setZeroCopyThreshold(size_t bytes);
+    // Broadcasts kept for clients resuming with "HELLO resume="; older ones get a snapshot.
+    // 0 disables resuming.
+    void setReplayCapacity(size_t broadcasts);
+    // Also publish every change and keyframe into a POSIX shared-memory ring for same-host
+    // readers (SharedSnapshotReader). Sensors beyond maxSensors are left out of it.
+    bool enableSharedSnapshots(const std::string& name = DEFAULT_SHARED_SNAPSHOT_NAME,
+                               size_t maxSensors = 65536, uint32_t slotCount = 8);
+    // Also record every broadcast state change in an on-disk journal (JournalWriter), read
+    // back with JournalReader. The directory keeps at most maxSegments segment files.
+    bool enableJournal(const std::string& directory, size_t segmentBytes = 16 * 1024 * 1024,
+                       size_t maxSegments = 64,
+                       std::chrono::milliseconds commitInterval = std::chrono::milliseconds(100));
 };
 
-#endif // TCP_SERVER_H
\ No newline at end of file
+#endif // TCP_SERVER_H
@@ -0,0 +1,90 @@
+#include "TimerWheel.h"
+#include <algorithm>
+
+TimerWheel::TimerWheel()
+    : slots(SLOT_COUNT), timerCount(0), wheelCount(0) {
+    cursor = Clock::time_point(std::chrono::milliseconds(slotTicks(Clock::now())));
+}
+
+int64_t TimerWheel::slotTicks(Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+void TimerWheel::schedule(uint64_t id, uint64_t cookie, Clock::time_point deadline) {
+    // Anything already due goes in the current slot so the next expire() picks it up
+    int64_t first = slotTicks(cursor);
+    int64_t tick = std::max(slotTicks(deadline), first);
+    timerCount++;
+    if (tick >= first + (int64_t)SLOT_COUNT) {
+        distant.push_back({id, cookie, deadline});
+        std::push_heap(distant.begin(), distant.end(), laterDeadline);
+        return;
+    }
+    slots[(size_t)tick % SLOT_COUNT].push_back({id, cookie, deadline});
+    wheelCount++;
+}
+
+void TimerWheel::expire(Clock::time_point now, std::vector<Timer>& expired) {
+    int64_t first = slotTicks(cursor);
+    int64_t last = slotTicks(now);
+    if (last < first || timerCount == 0) {
+        if (last >= first) cursor = Clock::time_point(std::chrono::milliseconds(last));
+        return;
+    }
+
+    // One lap covers every slot, however long the loop was away
+    int64_t end = std::min(last, first + (int64_t)SLOT_COUNT - 1);
+    for (int64_t tick = first; tick <= end; ++tick) {
+        std::vector<Timer>& slot = slots[(size_t)tick % SLOT_COUNT];
+        for (size_t i = 0; i < slot.size();) {
+            if (slot[i].deadline <= now) {
+                expired.push_back(slot[i]);
+                slot[i] = slot.back();
+                slot.pop_back();
+                timerCount--;
+                wheelCount--;
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    // The current slot may still hold timers due later within this millisecond
+    cursor = Clock::time_point(std::chrono::milliseconds(last));
+
+    // Distant timers now within a lap join the wheel, or expire if the loop overslept them
+    while (!distant.empty() && slotTicks(distant.front().deadline) < last + (int64_t)SLOT_COUNT) {
+        std::pop_heap(distant.begin(), distant.end(), laterDeadline);
+        Timer timer = distant.back();
+        distant.pop_back();
+        if (timer.deadline <= now) {
+            expired.push_back(timer);
+            timerCount--;
+        } else {
+            slots[(size_t)slotTicks(timer.deadline) % SLOT_COUNT].push_back(timer);
+            wheelCount++;
+        }
+    }
+}
+
+bool TimerWheel::nextDeadline(Clock::time_point& deadline) const {
+    if (wheelCount == 0) {
+        if (distant.empty()) return false;
+        deadline = distant.front().deadline;
+        return true;
+    }
+
+    // Every timer on the wheel is due within this lap, so the first occupied slot holds the
+    // earliest, and all distant timers are later still
+    int64_t first = slotTicks(cursor);
+    for (int64_t tick = first; tick < first + (int64_t)SLOT_COUNT; ++tick) {
+        const std::vector<Timer>& slot = slots[(size_t)tick % SLOT_COUNT];
+        if (slot.empty()) continue;
+        deadline = slot.front().deadline;
+        for (const Timer& timer : slot) {
+            deadline = std::min(deadline, timer.deadline);
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,52 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Single-level hashed timing wheel with one-millisecond slots.
+//
+// Timers are keyed by an opaque id and carry an absolute deadline, so periodic users
+// reschedule at previous deadline + period and never accumulate drift. Deadlines within
+// the wheel span (1024 ms, i.e. every rate down to 1 Hz) are inserted and expired in O(1).
+// Later ones wait in a min-heap and move onto the wheel once they come within a lap, so every
+// timer on the wheel is due within one lap and nextDeadline() never scans more than one slot's
+// timers.
+class TimerWheel {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Timer {
+        uint64_t id;
+        uint64_t cookie;  // Caller data, e.g. to detect timers of an object that was replaced
+        Clock::time_point deadline;
+    };
+
+private:
+    static const size_t SLOT_COUNT = 1024;
+
+    std::vector<std::vector<Timer>> slots;
+    std::vector<Timer> distant;  // Min-heap by deadline of timers beyond the current lap
+    Clock::time_point cursor;    // Start of the slot that has not been expired yet
+    size_t timerCount;
+    size_t wheelCount;           // Timers in slots rather than in distant
+
+    static int64_t slotTicks(Clock::time_point time);
+    static bool laterDeadline(const Timer& a, const Timer& b) { return a.deadline > b.deadline; }
+
+public:
+    TimerWheel();
+
+    void schedule(uint64_t id, uint64_t cookie, Clock::time_point deadline);
+
+    // Removes every timer with a deadline <= now and appends it to expired
+    void expire(Clock::time_point now, std::vector<Timer>& expired);
+
+    // Earliest pending deadline; returns false when the wheel is empty
+    bool nextDeadline(Clock::time_point& deadline) const;
+
+    size_t size() const { return timerCount; }
+};
+
+#endif // TIMER_WHEEL_H
@@ -1,18 +1,47 @@
 #include "UDPSocketListener.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <cstring>
 
 #ifdef _WIN32
     #pragma comment(lib, "ws2_32.lib")
     #pragma comment(lib, "wsock32.lib")
+#else
+    #include <sys/time.h>
+    #include <poll.h>
+    #include <fcntl.h>
+#endif
+#ifdef __linux__
+    #include <sys/eventfd.h>
+    #include <pthread.h>
+    #include <sched.h>
 #endif
 
-UDPSocketListener::UDPSocketListener(int port) 
-    : port(port), isListening(false) {
+// How long waitForMessages() polls the rings before it sleeps
+static const int WAIT_SPIN_US = 50;
+
 #ifdef _WIN32
-    socketFd = INVALID_SOCKET;
-#else
-    socketFd = -1;
+    // Without a wakeup handle waitForMessages() re-checks the rings at this interval
+    static const int MAX_WAIT_STEP_MS = 1;
+#endif
+
+UDPSocketListener::UDPSocketListener(int port) 
+    : port(port), slotSize(2048), slotCount(4096), overflowPolicy(UdpOverflowPolicy::DropNewest),
+      receiveThreads(1), receiveBufferSize(0), busyPollBudget(0), busyPollCpu(-1), nextShard(0), isListening(false), oversizedDrops(0),
+      overflowDrops(0), waiters(0), pollerRegistered(false), signalled(false) {
+#ifdef __linux__
+    eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#elif !defined(_WIN32)
+    if (pipe(eventPipe) < 0) {
+        eventPipe[0] = -1;
+        eventPipe[1] = -1;
+    }
+    for (int fd : eventPipe) {
+        if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
 #endif
 #ifdef _WIN32
     WSADATA wsaData;
@@ -22,44 +51,215 @@ UDPSocketListener::UDPSocketListener(int port)
 
 UDPSocketListener::~UDPSocketListener() {
     closeSocket();
+#ifdef __linux__
+    if (eventFd >= 0) close(eventFd);
+#elif !defined(_WIN32)
+    for (int fd : eventPipe) {
+        if (fd >= 0) close(fd);
+    }
+#endif
 #ifdef _WIN32
     WSACleanup();
 #endif
 }
 
-bool UDPSocketListener::openSocket() {
-    socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+void UDPSocketListener::setSlotSize(size_t bytes) {
+    slotSize = std::min(std::max(bytes, (size_t)64), MAX_SLOT_SIZE);
+}
+
+void UDPSocketListener::setSlotCount(size_t count) {
+    slotCount = std::max(count, (size_t)1);
+}
+
+void UDPSocketListener::setOverflowPolicy(UdpOverflowPolicy policy) {
+    overflowPolicy = policy;
+}
+
+void UDPSocketListener::setReceiveThreads(size_t count) {
+#ifdef __linux__
+    receiveThreads = std::max(count, (size_t)1);
+#else
+    // Elsewhere SO_REUSEPORT hands all unicast traffic to one socket
+    (void)count;
+    receiveThreads = 1;
+#endif
+}
+
+void UDPSocketListener::setReceiveBufferSize(int bytes) {
+    receiveBufferSize = std::max(bytes, 0);
+}
+
+void UDPSocketListener::setBusyPoll(std::chrono::microseconds budget, int firstCpu) {
+#ifdef __linux__
+    busyPollBudget = std::max(budget, std::chrono::microseconds(0));
+    busyPollCpu = firstCpu;
+#else
+    (void)budget;
+    (void)firstCpu;
+#endif
+}
+
+bool UDPSocketListener::joinMulticastGroup(const std::string& group, const std::string& interfaceAddress) {
+    MulticastMembership membership;
+    membership.interfaceAddress.s_addr = htonl(INADDR_ANY);
+    if (inet_pton(AF_INET, group.c_str(), &membership.group) != 1 ||
+        (ntohl(membership.group.s_addr) & 0xF0000000) != 0xE0000000) {
+        std::cerr << "Not a multicast group: " << group << std::endl;
+        return false;
+    }
+    if (!interfaceAddress.empty() &&
+        inet_pton(AF_INET, interfaceAddress.c_str(), &membership.interfaceAddress) != 1) {
+        std::cerr << "Invalid multicast interface address: " << interfaceAddress << std::endl;
+        return false;
+    }
+    memberships.push_back(membership);
+    return true;
+}
+
+// Creates, configures and binds one receive thread's socket. Socket options that affect
+// delivery are set before bind so no datagram arrives without them.
+bool UDPSocketListener::openShardSocket(ReceiveShard& shard, size_t index) {
+    shard.socketFd = socket(AF_INET, SOCK_DGRAM, 0);
 #ifdef _WIN32
-    if (socketFd == INVALID_SOCKET) {
+    if (shard.socketFd == INVALID_SOCKET) {
 #else
-    if (socketFd < 0) {
+    if (shard.socketFd < 0) {
 #endif
         std::cerr << "Failed to create socket" << std::endl;
         return false;
     }
 
+#ifdef __linux__
+    int enable = 1;
+    if (receiveThreads > 1 && setsockopt(shard.socketFd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+        std::cerr << "Failed to enable SO_REUSEPORT on port " << port << std::endl;
+        return false;
+    }
+    // Otherwise a socket bound to INADDR_ANY also gets the groups the other sockets joined
+    int multicastAll = 0;
+    if (!memberships.empty()) {
+        setsockopt(shard.socketFd, IPPROTO_IP, IP_MULTICAST_ALL, &multicastAll, sizeof(multicastAll));
+    }
+    // Arrival time of each datagram, to measure how long it waited in the socket buffer
+    setsockopt(shard.socketFd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+    if (busyPollBudget.count() > 0) {
+        int budget = (int)std::min<long long>(busyPollBudget.count(), INT32_MAX);
+        if (setsockopt(shard.socketFd, SOL_SOCKET, SO_BUSY_POLL, &budget, sizeof(budget)) < 0 && index == 0) {
+            std::cerr << "SO_BUSY_POLL refused; receive threads spin without kernel busy polling" << std::endl;
+        }
+    }
+#endif
+
+    if (receiveBufferSize > 0) {
+        setsockopt(shard.socketFd, SOL_SOCKET, SO_RCVBUF, (const char*)&receiveBufferSize, sizeof(receiveBufferSize));
+#ifdef __linux__
+        // Linux reports twice the size asked for, the rest being its bookkeeping
+        int actual = 0;
+        socklen_t length = sizeof(actual);
+        getsockopt(shard.socketFd, SOL_SOCKET, SO_RCVBUF, &actual, &length);
+        if (actual / 2 < receiveBufferSize) {
+            setsockopt(shard.socketFd, SOL_SOCKET, SO_RCVBUFFORCE, &receiveBufferSize, sizeof(receiveBufferSize));
+            getsockopt(shard.socketFd, SOL_SOCKET, SO_RCVBUF, &actual, &length);
+        }
+        if (actual / 2 < receiveBufferSize && index == 0) {
+            std::cerr << "UDP receive buffer capped at " << actual / 2 << " bytes; raise net.core.rmem_max to "
+                      << receiveBufferSize << std::endl;
+        }
+#endif
+    }
+
     struct sockaddr_in serverAddr;
     memset(&serverAddr, 0, sizeof(serverAddr));
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_addr.s_addr = INADDR_ANY;
     serverAddr.sin_port = htons(port);
 
-    if (bind(socketFd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+    if (bind(shard.socketFd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
         std::cerr << "Failed to bind socket to port " << port << std::endl;
+        return false;
+    }
+
+    // Groups are dealt out to the sockets in turn
+    for (size_t i = index; i < memberships.size(); i += receiveThreads) {
+        struct ip_mreq request;
+        request.imr_multiaddr = memberships[i].group;
+        request.imr_interface = memberships[i].interfaceAddress;
+        if (setsockopt(shard.socketFd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&request, sizeof(request)) < 0) {
+            char group[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &memberships[i].group, group, sizeof(group));
+            std::cerr << "Failed to join multicast group " << group << std::endl;
+            return false;
+        }
+    }
+
+    // Wakes the receive thread regularly so closeSocket() can stop it
 #ifdef _WIN32
-        closesocket(socketFd);
-        socketFd = INVALID_SOCKET;
+    DWORD timeout = 100;
 #else
-        close(socketFd);
-        socketFd = -1;
+    struct timeval timeout = {0, 100000};
 #endif
-        return false;
+    setsockopt(shard.socketFd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    return true;
+}
+
+void UDPSocketListener::pinReceiveThread(ReceiveShard& shard, size_t index) {
+#ifdef __linux__
+    if (busyPollBudget.count() == 0 || busyPollCpu < 0) return;
+    int cpu = busyPollCpu + (int)index;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (pthread_setaffinity_np(shard.thread.native_handle(), sizeof(cpus), &cpus) != 0) {
+        std::cerr << "Failed to pin UDP receive thread to CPU " << cpu << std::endl;
+    }
+#else
+    (void)shard;
+    (void)index;
+#endif
+}
+
+void UDPSocketListener::closeShardSockets() {
+    for (auto& shard : shards) {
+#ifdef _WIN32
+        if (shard->socketFd != INVALID_SOCKET) {
+            closesocket(shard->socketFd);
+            shard->socketFd = INVALID_SOCKET;
+        }
+#else
+        if (shard->socketFd >= 0) {
+            close(shard->socketFd);
+            shard->socketFd = -1;
+        }
+#endif
+    }
+}
+
+bool UDPSocketListener::openSocket() {
+    if (isListening) return false;
+
+    shards.clear();
+    for (size_t i = 0; i < receiveThreads; ++i) {
+        shards.push_back(std::make_unique<ReceiveShard>());
+        if (!openShardSocket(*shards.back(), i)) {
+            closeShardSockets();
+            shards.clear();
+            return false;
+        }
+        // Every slot is allocated and touched up front so the receive path never allocates
+        shards.back()->ring.create(slotCount, slotSize);
     }
 
     isListening = true;
-    listenerThread = std::thread(&UDPSocketListener::listenForMessages, this);
+    for (size_t i = 0; i < shards.size(); ++i) {
+        shards[i]->thread = std::thread(&UDPSocketListener::listenForMessages, this, std::ref(*shards[i]));
+        pinReceiveThread(*shards[i], i);
+    }
     
-    std::cout << "UDP socket listening on port " << port << std::endl;
+    std::cout << "UDP socket listening on port " << port;
+    if (shards.size() > 1) std::cout << " with " << shards.size() << " receive threads";
+    if (!memberships.empty()) std::cout << ", " << memberships.size() << " multicast groups";
+    if (busyPollBudget.count() > 0) std::cout << ", busy polling";
+    std::cout << std::endl;
     return true;
 }
 
@@ -67,69 +267,393 @@ void UDPSocketListener::closeSocket() {
     if (isListening) {
         isListening = false;
         
-        if (listenerThread.joinable()) {
-            listenerThread.join();
+        for (auto& shard : shards) {
+            if (shard->thread.joinable()) {
+                shard->thread.join();
+            }
         }
+        signalConsumers(true);
     }
-    
-#ifdef _WIN32
-    if (socketFd != INVALID_SOCKET) {
-        closesocket(socketFd);
-        socketFd = INVALID_SOCKET;
+    closeShardSockets();
+}
+
+// One metrics update per batch. arrived counts datagrams taken from the socket; the dropped
+// ones may have arrived earlier.
+void UDPSocketListener::countReceived(size_t arrived, size_t oversized, size_t overflowed) {
+    Metrics::add(MetricCounter::UdpDatagramsReceived, arrived);
+    if (oversized + overflowed == 0) return;
+    Metrics::add(MetricCounter::UdpDatagramsDropped, oversized + overflowed);
+    if (oversized > 0) oversizedDrops.fetch_add(oversized, std::memory_order_relaxed);
+    if (overflowed > 0) {
+        overflowDrops.fetch_add(overflowed, std::memory_order_relaxed);
+        Metrics::add(MetricCounter::UdpDatagramsOverflowed, overflowed);
     }
-#else
-    if (socketFd >= 0) {
-        close(socketFd);
-        socketFd = -1;
+}
+
+#ifdef __linux__
+// The kernel stamps arrivals with the realtime clock. Moved back from the steady time the
+// receive call returned by how long ago that was, they compare with other steady times.
+static bool kernelArrival(msghdr& header, std::chrono::steady_clock::time_point now,
+                          std::chrono::system_clock::time_point realNow, std::chrono::steady_clock::time_point& arrival) {
+    for (cmsghdr* control = CMSG_FIRSTHDR(&header); control; control = CMSG_NXTHDR(&header, control)) {
+        if (control->cmsg_level != SOL_SOCKET || control->cmsg_type != SCM_TIMESTAMPNS) continue;
+        timespec stamp;
+        memcpy(&stamp, CMSG_DATA(control), sizeof(stamp));
+        auto arrived = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::seconds(stamp.tv_sec) + std::chrono::nanoseconds(stamp.tv_nsec)));
+        // A clock step can put the stamp in the future
+        auto waited = std::max(realNow - arrived, std::chrono::system_clock::duration(0));
+        arrival = now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(waited);
+        return true;
     }
-#endif
+    return false;
 }
+#endif
 
-void UDPSocketListener::listenForMessages() {
-    char buffer[1024];
+// The ring is full: the next datagram is received aside, then either replaces the oldest
+// waiting one or is dropped
+bool UDPSocketListener::receiveOverflow(ReceiveShard& shard, std::vector<char>& overflow, uint64_t position) {
+    DatagramRing& ring = shard.ring;
     struct sockaddr_in clientAddr;
 #ifdef _WIN32
     int clientAddrLen = sizeof(clientAddr);
+    int bytesReceived = recvfrom(shard.socketFd, overflow.data(), (int)slotSize, 0,
+                                (struct sockaddr*)&clientAddr, &clientAddrLen);
+    bool truncated = bytesReceived < 0 && WSAGetLastError() == WSAEMSGSIZE;
 #else
     socklen_t clientAddrLen = sizeof(clientAddr);
+    ssize_t bytesReceived = recvfrom(shard.socketFd, overflow.data(), slotSize, MSG_TRUNC,
+                                    (struct sockaddr*)&clientAddr, &clientAddrLen);
+    bool truncated = bytesReceived > (ssize_t)slotSize;
+#endif
+    if (truncated) {
+        countReceived(1, 1, 0);
+        return false;
+    }
+    if (bytesReceived < 0) return false;
+
+    // A datagram discarded at receive time was already counted
+    uint64_t oldest = position - ring.capacity();
+    bool skipped = ring.length(oldest) == DatagramRing::SKIPPED;
+    if (overflowPolicy != UdpOverflowPolicy::DropOldest || !ring.reclaimOldest(position)) {
+        countReceived(1, 0, 1);
+        return false;
+    }
+    memcpy(ring.slotData(position), overflow.data(), (size_t)bytesReceived);
+    ring.slotData(position)[bytesReceived] = '\0';
+    ring.slotSource(position) = clientAddr;
+    auto now = std::chrono::steady_clock::now();
+    ring.publish(position, (uint32_t)bytesReceived, now, now);
+    signalConsumers();
+    countReceived(1, 0, skipped ? 0 : 1);
+    return true;
+}
+
+void UDPSocketListener::listenForMessages(ReceiveShard& shard) {
+    DatagramRing& ring = shard.ring;
+    // Cells [position, position + armed) are free and handed to the next receive
+    uint64_t position = 0;
+    size_t armed = 0;
+    std::vector<char> overflow(slotSize);
+#ifdef __linux__
+    union ControlBuffer {
+        cmsghdr header;
+        char data[CMSG_SPACE(sizeof(timespec))];
+    };
+    std::vector<mmsghdr> headers(RECEIVE_BATCH);
+    std::vector<iovec> vectors(RECEIVE_BATCH);
+    std::vector<ControlBuffer> controls(RECEIVE_BATCH);
+    // Busy polling never blocks; the socket's SO_BUSY_POLL budget spins inside each call
+    int flags = busyPollBudget.count() > 0 ? MSG_DONTWAIT : MSG_WAITFORONE;
 #endif
 
     while (isListening) {
-#ifdef _WIN32
-        int bytesReceived = recvfrom(socketFd, buffer, sizeof(buffer) - 1, 0, 
-                                    (struct sockaddr*)&clientAddr, &clientAddrLen);
+        while (armed < RECEIVE_BATCH && ring.isFree(position + armed)) {
+            armed++;
+        }
+
+        if (armed == 0) {
+            if (overflowPolicy == UdpOverflowPolicy::Block) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            } else if (receiveOverflow(shard, overflow, position)) {
+                position++;
+            }
+            continue;
+        }
+
+        size_t oversized = 0;
+#ifdef __linux__
+        // MSG_WAITFORONE blocks for the first datagram only, then takes whatever else is queued
+        for (size_t i = 0; i < armed; ++i) {
+            vectors[i].iov_base = ring.slotData(position + i);
+            vectors[i].iov_len = slotSize;
+            memset(&headers[i].msg_hdr, 0, sizeof(headers[i].msg_hdr));
+            headers[i].msg_hdr.msg_name = &ring.slotSource(position + i);
+            headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            headers[i].msg_hdr.msg_iov = &vectors[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            headers[i].msg_hdr.msg_control = controls[i].data;
+            headers[i].msg_hdr.msg_controllen = sizeof(controls[i].data);
+        }
+        int batch = recvmmsg(shard.socketFd, headers.data(), (unsigned int)armed, flags, nullptr);
+        if (batch <= 0) continue;
+        auto queuedAt = std::chrono::steady_clock::now();
+        auto realNow = std::chrono::system_clock::now();
+
+        // An oversized datagram is cut short and would parse as garbage. Its cell is published
+        // as skipped, since later datagrams in the batch already sit behind it.
+        for (int i = 0; i < batch; ++i) {
+            uint32_t length = headers[i].msg_len;
+            if (headers[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                length = DatagramRing::SKIPPED;
+                oversized++;
+            } else {
+                ring.slotData(position + i)[length] = '\0';
+            }
+            auto receivedAt = queuedAt;
+            if (kernelArrival(headers[i].msg_hdr, queuedAt, realNow, receivedAt)) {
+                Metrics::record(MetricHistogram::UdpSocketResidencyNs,
+                                (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(queuedAt - receivedAt).count());
+            }
+            ring.publish(position + i, length, receivedAt, queuedAt);
+        }
+        position += batch;
+        armed -= batch;
+        signalConsumers();
+        countReceived(batch, oversized, 0);
 #else
-        ssize_t bytesReceived = recvfrom(socketFd, buffer, sizeof(buffer) - 1, 0, 
+        struct sockaddr_in& clientAddr = ring.slotSource(position);
+    #ifdef _WIN32
+        int clientAddrLen = sizeof(clientAddr);
+        int bytesReceived = recvfrom(shard.socketFd, ring.slotData(position), (int)slotSize, 0,
+                                    (struct sockaddr*)&clientAddr, &clientAddrLen);
+        bool truncated = bytesReceived < 0 && WSAGetLastError() == WSAEMSGSIZE;
+    #else
+        // MSG_TRUNC reports the real length, so an oversized datagram is detected and dropped
+        socklen_t clientAddrLen = sizeof(clientAddr);
+        ssize_t bytesReceived = recvfrom(shard.socketFd, ring.slotData(position), slotSize, MSG_TRUNC,
                                         (struct sockaddr*)&clientAddr, &clientAddrLen);
-#endif
-        
-        if (bytesReceived > 0) {
-            buffer[bytesReceived] = '\0';
-            std::string message(buffer);
-            
-            std::lock_guard<std::mutex> lock(queueMutex);
-            messageQueue.push(message);
+        bool truncated = bytesReceived > (ssize_t)slotSize;
+    #endif
+        if (truncated) {
+            countReceived(1, 1, 0);
+        } else if (bytesReceived >= 0) {
+            ring.slotData(position)[bytesReceived] = '\0';
+            auto now = std::chrono::steady_clock::now();
+            ring.publish(position, (uint32_t)bytesReceived, now, now);
+            position++;
+            armed--;
+            signalConsumers();
+            countReceived(1, 0, 0);
         }
+#endif
+    }
+}
+
+size_t UDPSocketListener::queuedCount() const {
+    size_t queued = 0;
+    for (const auto& shard : shards) {
+        queued += shard->ring.size();
     }
+    return queued;
 }
 
 bool UDPSocketListener::hasMessages() const {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    return !messageQueue.empty();
+    return queuedCount() > 0;
 }
 
 std::string UDPSocketListener::getNextMessage() {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    if (messageQueue.empty()) {
-        return "";
+    std::string message;
+    getNextMessage(message);
+    return message;
+}
+
+bool UDPSocketListener::getNextMessage(std::string& message) {
+    UdpDatagram datagram;
+    if (!nextDatagram(datagram)) {
+        message.clear();
+        return false;
     }
     
-    std::string message = messageQueue.front();
-    messageQueue.pop();
-    return message;
+    message.assign(datagram.data, datagram.size);
+    releaseDatagram(datagram);
+    return true;
 }
 
 size_t UDPSocketListener::getQueueSize() const {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    return messageQueue.size();
-}
\ No newline at end of file
+    return queuedCount();
+}
+
+static void recordQueueResidency(std::chrono::steady_clock::time_point queuedAt,
+                                 std::chrono::steady_clock::time_point now) {
+    auto residency = std::max(now - queuedAt, std::chrono::steady_clock::duration(0));
+    Metrics::record(MetricHistogram::UdpQueueResidencyNs,
+                    (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(residency).count());
+}
+
+bool UDPSocketListener::nextDatagram(UdpDatagram& datagram) {
+    size_t count = shards.size();
+    size_t start = count > 1 ? nextShard.fetch_add(1, std::memory_order_relaxed) : 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t index = (uint32_t)((start + i) % count);
+        DatagramRing& ring = shards[index]->ring;
+        uint64_t position;
+        while (ring.claim(position)) {
+            uint32_t length = ring.length(position);
+            if (length == DatagramRing::SKIPPED) {
+                ring.release(position);
+                continue;
+            }
+            datagram.data = ring.data(position);
+            datagram.size = length;
+            datagram.source = ring.source(position);
+            datagram.receivedAt = ring.receivedAt(position);
+            datagram.position = position;
+            datagram.shard = index;
+            recordQueueResidency(ring.queuedAt(position), std::chrono::steady_clock::now());
+            return true;
+        }
+    }
+    return false;
+}
+
+void UDPSocketListener::releaseDatagram(const UdpDatagram& datagram) {
+    shards[datagram.shard]->ring.release(datagram.position);
+}
+
+// Skipped when nobody could be waiting, so a busy consumer costs the receive thread no syscall.
+// The fences pair with the ones in waitForMessages() and clearSignal(): either the consumer sees
+// the published datagram, or this sees the consumer and writes.
+void UDPSocketListener::signalConsumers(bool always) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!always && waiters.load(std::memory_order_relaxed) == 0 && !pollerRegistered.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (signalled.exchange(true) && !always) return;
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t ignored = write(eventFd, &one, sizeof(one));
+    (void)ignored;
+#elif !defined(_WIN32)
+    char one = 1;
+    ssize_t ignored = write(eventPipe[1], &one, 1);
+    (void)ignored;
+#endif
+}
+
+void UDPSocketListener::clearSignal() {
+    if (!signalled.load(std::memory_order_relaxed)) return;
+#ifdef __linux__
+    uint64_t count;
+    ssize_t ignored = read(eventFd, &count, sizeof(count));
+    (void)ignored;
+#elif !defined(_WIN32)
+    char drain[64];
+    while (read(eventPipe[0], drain, sizeof(drain)) > 0) {
+    }
+#endif
+    signalled.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+bool UDPSocketListener::waitForMessages(std::chrono::milliseconds timeout) {
+    if (queuedCount() > 0) return true;
+
+    // A burst usually continues within microseconds; catching that without a sleep and a
+    // wakeup saves both threads a context switch
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto spinUntil = std::chrono::steady_clock::now() + std::min<std::chrono::steady_clock::duration>(
+        timeout, std::chrono::microseconds(WAIT_SPIN_US));
+    while (std::chrono::steady_clock::now() < spinUntil) {
+        std::this_thread::yield();
+        if (queuedCount() > 0) return true;
+    }
+
+    waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (queuedCount() == 0 && isListening) {
+        // A wakeup left over from datagrams that were already taken
+        if (signalled.load(std::memory_order_relaxed)) {
+            clearSignal();
+            continue;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now() + std::chrono::microseconds(999));
+        if (remaining.count() <= 0) break;
+#ifdef _WIN32
+        std::this_thread::sleep_for(std::min(remaining, std::chrono::milliseconds(MAX_WAIT_STEP_MS)));
+#else
+    #ifdef __linux__
+        struct pollfd wakeup = {eventFd, POLLIN, 0};
+    #else
+        struct pollfd wakeup = {eventPipe[0], POLLIN, 0};
+    #endif
+        poll(&wakeup, 1, (int)std::min<long long>(remaining.count(), INT32_MAX));
+#endif
+    }
+    waiters.fetch_sub(1);
+    return queuedCount() > 0;
+}
+
+// Claims up to max datagrams from one ring with a single compare-and-swap
+size_t UDPSocketListener::takeBatch(DatagramRing& ring, uint32_t shard, std::vector<UdpDatagram>& datagrams,
+                                    size_t max) {
+    uint64_t first;
+    size_t claimed;
+    size_t taken = 0;
+    // A batch of nothing but skipped cells is not the end of the queue
+    while (taken == 0 && (claimed = ring.claimBatch(first, max)) > 0) {
+        auto now = std::chrono::steady_clock::now();
+        for (uint64_t position = first; position < first + claimed; ++position) {
+            uint32_t length = ring.length(position);
+            if (length == DatagramRing::SKIPPED) {
+                ring.release(position);
+                continue;
+            }
+            datagrams.push_back(UdpDatagram{ring.data(position), length, ring.source(position),
+                                            ring.receivedAt(position), position, shard});
+            recordQueueResidency(ring.queuedAt(position), now);
+            taken++;
+        }
+    }
+    return taken;
+}
+
+size_t UDPSocketListener::drain(std::vector<UdpDatagram>& datagrams, size_t max) {
+    auto take = [&]() {
+        size_t count = shards.size();
+        size_t start = count > 1 ? nextShard.fetch_add(1, std::memory_order_relaxed) : 0;
+        size_t taken = 0;
+        for (size_t i = 0; i < count && taken < max; ++i) {
+            uint32_t index = (uint32_t)((start + i) % count);
+            taken += takeBatch(shards[index]->ring, index, datagrams, max - taken);
+        }
+        return taken;
+    };
+
+    // The wakeup is only re-armed once the rings are empty, so a consumer keeping up with a
+    // burst is signalled once for it
+    size_t taken = take();
+    if (taken == 0 && signalled.load(std::memory_order_relaxed)) {
+        clearSignal();
+        taken = take();
+    }
+    return taken;
+}
+
+void UDPSocketListener::releaseDatagrams(const std::vector<UdpDatagram>& datagrams) {
+    for (const UdpDatagram& datagram : datagrams) {
+        shards[datagram.shard]->ring.release(datagram.position);
+    }
+}
+
+int UDPSocketListener::getEventFd() {
+    pollerRegistered = true;
+#ifdef __linux__
+    return eventFd;
+#elif !defined(_WIN32)
+    return eventPipe[0];
+#else
+    return -1;
+#endif
+}
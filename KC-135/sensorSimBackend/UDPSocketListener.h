@@ -2,10 +2,13 @@
 #define UDP_SOCKET_LISTENER_H
 
 #include <string>
-#include <queue>
+#include <string_view>
+#include <vector>
+#include <memory>
 #include <thread>
-#include <mutex>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 
 #ifdef _WIN32
     #define WIN32_LEAN_AND_MEAN
@@ -19,30 +22,160 @@
     #include <unistd.h>
 #endif
 
+#include "DatagramRing.h"
+
+// A received datagram, read in place from the listener's ring. Valid until it is passed to
+// releaseDatagram(); data is NUL-terminated for text payloads.
+struct UdpDatagram {
+    const char* data;
+    size_t size;
+    sockaddr_in source;
+    // Arrival at the socket: the kernel's timestamp on Linux, elsewhere when the receive
+    // thread read it
+    std::chrono::steady_clock::time_point receivedAt;
+    uint64_t position;
+    uint32_t shard;
+
+    std::string_view text() const { return std::string_view(data, size); }
+};
+
+// What the receive thread does with a datagram when every ring slot is taken
+enum class UdpOverflowPolicy {
+    DropNewest,   // Discard the arriving datagram
+    DropOldest,   // Discard the oldest datagram no consumer has taken yet
+    Block         // Stop reading until a slot frees up; the kernel buffer absorbs what it can
+};
+
+// Receives datagrams on background threads into bounded lock-free rings of preallocated
+// slots (DatagramRing), which any number of consumers read in place. On Linux up to a batch of
+// datagrams is read per recvmmsg call. A datagram larger than a slot is dropped, and a full
+// ring is handled by the overflow policy; both are counted.
+//
+// With several receive threads each has its own SO_REUSEPORT socket and ring, and the kernel
+// spreads unicast senders across them by address and port. Multicast groups are spread across
+// the sockets instead, one group per socket in turn, since Linux hands every socket of a
+// SO_REUSEPORT group its own copy of a multicast datagram. Datagrams from one sender or group
+// therefore stay on one thread and in order; consumers take from all rings in turn.
 class UDPSocketListener {
 private:
+    struct MulticastMembership {
+        in_addr group;
+        in_addr interfaceAddress;
+    };
+
+    // What one receive thread owns; nothing in it is shared with the other receive threads
+    struct ReceiveShard {
 #ifdef _WIN32
-    SOCKET socketFd;
+        SOCKET socketFd;
 #else
-    int socketFd;
+        int socketFd;
 #endif
+        DatagramRing ring;
+        std::thread thread;
+    };
+
     int port;
-    std::queue<std::string> messageQueue;
-    mutable std::mutex queueMutex;
-    std::thread listenerThread;
+    size_t slotSize;
+    size_t slotCount;
+    UdpOverflowPolicy overflowPolicy;
+    size_t receiveThreads;
+    int receiveBufferSize;
+    std::chrono::microseconds busyPollBudget;   // Zero unless busy polling
+    int busyPollCpu;
+    std::vector<MulticastMembership> memberships;
+    // Kept after closeSocket() so late consumers still find their rings; replaced by openSocket()
+    std::vector<std::unique_ptr<ReceiveShard>> shards;
+    std::atomic<size_t> nextShard;   // Where consumers start looking, so no ring is starved
     std::atomic<bool> isListening;
-    
-    void listenForMessages();
+    std::atomic<uint64_t> oversizedDrops;
+    std::atomic<uint64_t> overflowDrops;
+
+    // Consumer wakeup: written when datagrams are published while someone waits or polls
+#ifdef __linux__
+    int eventFd;
+#elif !defined(_WIN32)
+    int eventPipe[2];
+#endif
+    std::atomic<int> waiters;
+    std::atomic<bool> pollerRegistered;
+    std::atomic<bool> signalled;  // An unread wakeup is pending
+
+    void signalConsumers(bool always = false);
+    void clearSignal();
+
+    bool openShardSocket(ReceiveShard& shard, size_t index);
+    void pinReceiveThread(ReceiveShard& shard, size_t index);
+    void closeShardSockets();
+    size_t queuedCount() const;
+    size_t takeBatch(DatagramRing& ring, uint32_t shard, std::vector<UdpDatagram>& datagrams, size_t max);
+
+    void countReceived(size_t arrived, size_t oversized, size_t overflowed);
+    bool receiveOverflow(ReceiveShard& shard, std::vector<char>& overflow, uint64_t position);
+    void listenForMessages(ReceiveShard& shard);
 
 public:
+    // Datagrams above this are dropped whatever the slot size
+    static constexpr size_t MAX_SLOT_SIZE = 65536;
+    // Datagrams read per system call at most
+    static constexpr size_t RECEIVE_BATCH = 64;
+
     UDPSocketListener(int port);
     ~UDPSocketListener();
-    
+
+    // Must be called before openSocket(). Largest datagram accepted, up to MAX_SLOT_SIZE.
+    void setSlotSize(size_t bytes);
+    // Must be called before openSocket(). Datagrams that can be queued or held at once per
+    // receive thread, rounded up to a power of two.
+    void setSlotCount(size_t count);
+    // Must be called before openSocket(); DropNewest by default
+    void setOverflowPolicy(UdpOverflowPolicy policy);
+    // Must be called before openSocket(); 1 by default. Only Linux balances SO_REUSEPORT
+    // sockets, so elsewhere there is always one.
+    void setReceiveThreads(size_t count);
+    // Must be called before openSocket(). Kernel receive buffer per socket, which holds a burst
+    // while the receive thread catches up; 0 keeps the system default. Above net.core.rmem_max
+    // it takes CAP_NET_ADMIN, otherwise the buffer is capped and a warning logged.
+    void setReceiveBufferSize(int bytes);
+    // Must be called before openSocket(). Joins group on the interface with interfaceAddress,
+    // or one the routing table picks if it is empty. False if either address is invalid.
+    bool joinMulticastGroup(const std::string& group, const std::string& interfaceAddress = "");
+    // Must be called before openSocket(); Linux only. For latency-critical deployments: the
+    // receive threads never sleep but spin on non-blocking receives, each using a whole core,
+    // and SO_BUSY_POLL lets each receive call poll the NIC queue for up to budget. Setting
+    // budget above net.core.busy_read takes CAP_NET_ADMIN. With firstCpu >= 0, receive
+    // thread i is pinned to CPU firstCpu + i. A zero budget turns it off.
+    void setBusyPoll(std::chrono::microseconds budget, int firstCpu = -1);
+
     bool openSocket();
+    // Datagrams still held by consumers stay valid until the next openSocket()
     void closeSocket();
+    size_t getReceiveThreads() const { return shards.size(); }
     bool hasMessages() const;
+    // Copies the next datagram out and frees its slot; empty if none is queued
     std::string getNextMessage();
+    // Same, into message's existing buffer; false if none is queued
+    bool getNextMessage(std::string& message);
     size_t getQueueSize() const;
+
+    // The next datagram without copying it; false if none is queued. Its slot stays taken
+    // until releaseDatagram(), and the receive thread cannot refill slots past it meanwhile.
+    bool nextDatagram(UdpDatagram& datagram);
+    void releaseDatagram(const UdpDatagram& datagram);
+
+    // Sleeps until a datagram is queued or timeout passes, woken by the receive thread.
+    // Returns whether one is queued.
+    bool waitForMessages(std::chrono::milliseconds timeout);
+    // Takes up to max queued datagrams at once and appends them to datagrams; returns how
+    // many. Each must be given back with releaseDatagram() or releaseDatagrams().
+    size_t drain(std::vector<UdpDatagram>& datagrams, size_t max);
+    void releaseDatagrams(const std::vector<UdpDatagram>& datagrams);
+    // For the caller's own poll or epoll loop: readable when datagrams may be queued. Once it
+    // is, call drain() until it returns 0. -1 on Windows, where waitForMessages() polls.
+    int getEventFd();
+
+    // Datagrams dropped for being larger than a slot, and by the overflow policy
+    uint64_t getOversizedDrops() const { return oversizedDrops; }
+    uint64_t getOverflowDrops() const { return overflowDrops; }
 };
 
-#endif // UDP_SOCKET_LISTENER_H
\ No newline at end of file
+#endif // UDP_SOCKET_LISTENER_H
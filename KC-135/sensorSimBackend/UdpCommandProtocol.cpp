@@ -0,0 +1,98 @@
+#include "UdpCommandProtocol.h"
+
+// Protobuf wire types
+static const uint64_t WIRE_VARINT = 0;
+static const uint64_t WIRE_FIXED64 = 1;
+static const uint64_t WIRE_LENGTH_DELIMITED = 2;
+static const uint64_t WIRE_FIXED32 = 5;
+
+bool UdpCommandProtocol::readVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (cursor == end) return false;
+        uint8_t byte = *cursor++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+bool UdpCommandProtocol::decodeCommand(const char* data, size_t size, Command& command) {
+    const uint8_t* cursor = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = cursor + size;
+    uint64_t value = Start;
+
+    while (cursor < end) {
+        uint64_t tag;
+        if (!readVarint(cursor, end, tag)) return false;
+        uint64_t field = tag >> 3;
+        uint64_t wireType = tag & 7;
+        if (field == 0) return false;
+
+        uint64_t skip = 0;
+        if (wireType == WIRE_VARINT) {
+            uint64_t fieldValue;
+            if (!readVarint(cursor, end, fieldValue)) return false;
+            // The last occurrence of a field wins
+            if (field == 1) value = fieldValue;
+        } else if (wireType == WIRE_FIXED64) {
+            skip = 8;
+        } else if (wireType == WIRE_LENGTH_DELIMITED) {
+            if (!readVarint(cursor, end, skip)) return false;
+        } else if (wireType == WIRE_FIXED32) {
+            skip = 4;
+        } else {
+            return false;
+        }
+        if (field == 1 && wireType != WIRE_VARINT) return false;
+        if (skip > (uint64_t)(end - cursor)) return false;
+        cursor += skip;
+    }
+
+    if (value > Shutdown) return false;
+    command = (Command)value;
+    return true;
+}
+
+size_t UdpCommandProtocol::stateUpdateCount(const char* data, size_t size) {
+    if (size < STATE_UPDATE_HEADER_SIZE || (uint8_t)data[0] != STATE_UPDATE_MAGIC ||
+        (uint8_t)data[1] != STATE_UPDATE_VERSION) {
+        return 0;
+    }
+    size_t count = (size_t)(uint8_t)data[2] | (size_t)(uint8_t)data[3] << 8;
+    if (size != STATE_UPDATE_HEADER_SIZE + count * STATE_UPDATE_ENTRY_SIZE) return 0;
+    return count;
+}
+
+void UdpCommandProtocol::stateUpdateEntry(const char* data, size_t index, uint32_t& id, uint8_t& state) {
+    const uint8_t* entry = reinterpret_cast<const uint8_t*>(data) + STATE_UPDATE_HEADER_SIZE +
+                           index * STATE_UPDATE_ENTRY_SIZE;
+    id = (uint32_t)entry[0] | (uint32_t)entry[1] << 8 | (uint32_t)entry[2] << 16 | (uint32_t)entry[3] << 24;
+    state = entry[4];
+}
+
+std::string UdpCommandProtocol::encodeCommand(Command command) {
+    std::string message;
+    // START is the default and is left out, as protobuf encoders do
+    if (command != Start) {
+        message.push_back((char)(1 << 3 | WIRE_VARINT));
+        message.push_back((char)command);
+    }
+    return message;
+}
+
+std::string UdpCommandProtocol::encodeStateUpdate(const uint32_t* ids, const uint8_t* states, size_t count) {
+    std::string datagram;
+    datagram.reserve(STATE_UPDATE_HEADER_SIZE + count * STATE_UPDATE_ENTRY_SIZE);
+    datagram.push_back((char)STATE_UPDATE_MAGIC);
+    datagram.push_back((char)STATE_UPDATE_VERSION);
+    datagram.push_back((char)(count & 0xFF));
+    datagram.push_back((char)(count >> 8 & 0xFF));
+    for (size_t i = 0; i < count; ++i) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            datagram.push_back((char)(ids[i] >> shift & 0xFF));
+        }
+        datagram.push_back((char)states[i]);
+    }
+    return datagram;
+}
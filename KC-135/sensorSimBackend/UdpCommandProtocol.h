@@ -0,0 +1,52 @@
+#ifndef UDP_COMMAND_PROTOCOL_H
+#define UDP_COMMAND_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Datagrams accepted on the controller's UDP command port, see CommandDispatcher.
+//
+//   Command       a protobuf CommandMessage from ProtoTest/proto/command.proto at the top of
+//                 the repository, as ProtoTest's Command.cs sends it. proto3 leaves out a field
+//                 holding its default, so an empty datagram is START.
+//   StateUpdate   u8 0x5E, u8 version 1, u16 count, count x { u32 id, u8 state }
+//
+// All integers are little-endian and sensor IDs are the SensorRegistry IDs. 0x5E has protobuf
+// wire type 6, which does not exist, so no CommandMessage can start with it. One state update
+// can carry as many sensors as fit in a datagram.
+//
+// Decoding reads the datagram in place; nothing is copied or allocated.
+class UdpCommandProtocol {
+public:
+    // Values of the Command enum in command.proto
+    enum Command : uint8_t {
+        Start    = 0,
+        Stop     = 1,
+        Shutdown = 2
+    };
+
+    static const uint8_t STATE_UPDATE_MAGIC = 0x5E;
+    static const uint8_t STATE_UPDATE_VERSION = 1;
+    static const size_t STATE_UPDATE_HEADER_SIZE = 4;
+    static const size_t STATE_UPDATE_ENTRY_SIZE = 5;
+
+    static bool isStateUpdate(const char* data, size_t size) {
+        return size > 0 && (uint8_t)data[0] == STATE_UPDATE_MAGIC;
+    }
+    // False if it is not a well-formed CommandMessage or names an unknown command. Unknown
+    // fields are skipped, as protobuf requires.
+    static bool decodeCommand(const char* data, size_t size, Command& command);
+    // Number of entries, or 0 if the header or length is wrong
+    static size_t stateUpdateCount(const char* data, size_t size);
+    static void stateUpdateEntry(const char* data, size_t index, uint32_t& id, uint8_t& state);
+
+    // For senders and tests
+    static std::string encodeCommand(Command command);
+    static std::string encodeStateUpdate(const uint32_t* ids, const uint8_t* states, size_t count);
+
+private:
+    static bool readVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& value);
+};
+
+#endif // UDP_COMMAND_PROTOCOL_H
@@ -0,0 +1,318 @@
+#include "UringTransport.h"
+
+#ifdef URING_TRANSPORT_SUPPORTED
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+static int uringSetup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int uringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+UringTransport::UringTransport()
+    : ringFd(-1), sqRing(nullptr), sqRingSize(0), cqRing(nullptr), cqRingSize(0), sqes(nullptr), sqesSize(0),
+      sqHead(nullptr), sqTail(nullptr), sqFlags(nullptr), sqArray(nullptr), sqMask(0), sqEntries(0),
+      cqHead(nullptr), cqTail(nullptr), cqMask(0), cqes(nullptr), unsubmitted(0), bufferSlots(0),
+      zeroCopySupported(false) {}
+
+UringTransport::~UringTransport() {
+    close();
+}
+
+bool UringTransport::open(unsigned entries, uint32_t registeredBuffers) {
+    if (ringFd >= 0) return false;
+
+    // Room for a send and a zero-copy notification per submission, so completions never
+    // back up into the kernel's overflow list in normal operation
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+#ifdef IORING_SETUP_SUBMIT_ALL
+    params.flags |= IORING_SETUP_SUBMIT_ALL;
+#endif
+    params.cq_entries = entries * 4;
+    ringFd = uringSetup(entries, &params);
+    if (ringFd < 0 && errno == EINVAL && params.flags != IORING_SETUP_CQSIZE) {
+        // Kernels before 5.18 lack SUBMIT_ALL; submit() copes with partial submission
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        ringFd = uringSetup(entries, &params);
+    }
+    if (ringFd < 0) return false;
+
+    // Without NODROP a burst of completions could be lost along with the sends they report
+    if (!(params.features & IORING_FEAT_NODROP)) {
+        close();
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize = std::max(sqRingSize, cqRingSize);
+        cqRingSize = 0;
+    }
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        close();
+        return false;
+    }
+    if (cqRingSize > 0) {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            close();
+            return false;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqeMemory = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqeMemory == MAP_FAILED) {
+        close();
+        return false;
+    }
+    sqes = (io_uring_sqe*)sqeMemory;
+
+    char* sq = (char*)sqRing;
+    char* cq = cqRing ? (char*)cqRing : sq;
+    sqHead = (unsigned*)(sq + params.sq_off.head);
+    sqTail = (unsigned*)(sq + params.sq_off.tail);
+    sqFlags = (unsigned*)(sq + params.sq_off.flags);
+    sqArray = (unsigned*)(sq + params.sq_off.array);
+    sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    sqEntries = *(unsigned*)(sq + params.sq_off.ring_entries);
+    cqHead = (unsigned*)(cq + params.cq_off.head);
+    cqTail = (unsigned*)(cq + params.cq_off.tail);
+    cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+    unsubmitted = 0;
+
+    bool zeroCopy = false;
+    if (!probe(zeroCopy)) {
+        close();
+        return false;
+    }
+
+#ifdef IORING_RECVSEND_FIXED_BUF
+    // A sparse table is filled slot by slot as frames are registered
+    if (zeroCopy && registeredBuffers > 0) {
+        struct io_uring_rsrc_register table;
+        memset(&table, 0, sizeof(table));
+        table.nr = registeredBuffers;
+        table.flags = IORING_RSRC_REGISTER_SPARSE;
+        if (uringRegister(ringFd, IORING_REGISTER_BUFFERS2, &table, sizeof(table)) == 0) {
+            bufferSlots = registeredBuffers;
+            zeroCopySupported = true;
+        }
+    }
+#else
+    (void)registeredBuffers;
+#endif
+    return true;
+}
+
+// The operations the server relies on must all be there; zero-copy sends are a bonus
+bool UringTransport::probe(bool& zeroCopy) {
+    static const unsigned PROBE_OPS = 256;
+    std::vector<uint8_t> buffer(sizeof(struct io_uring_probe) + PROBE_OPS * sizeof(struct io_uring_probe_op));
+    struct io_uring_probe* result = (struct io_uring_probe*)buffer.data();
+    if (uringRegister(ringFd, IORING_REGISTER_PROBE, result, PROBE_OPS) < 0) return false;
+
+    auto supported = [result](unsigned op) {
+        return op <= result->last_op && (result->ops[op].flags & IO_URING_OP_SUPPORTED);
+    };
+    zeroCopy = false;
+#ifdef IORING_RECVSEND_FIXED_BUF
+    zeroCopy = supported(IORING_OP_SEND_ZC);
+#endif
+    return supported(IORING_OP_SENDMSG) && supported(IORING_OP_ACCEPT) && supported(IORING_OP_ASYNC_CANCEL);
+}
+
+void UringTransport::close() {
+    if (sqes) munmap(sqes, sqesSize);
+    if (cqRing) munmap(cqRing, cqRingSize);
+    if (sqRing) munmap(sqRing, sqRingSize);
+    sqes = nullptr;
+    cqRing = nullptr;
+    sqRing = nullptr;
+
+    // Requests still in flight are cancelled by the kernel as the ring goes away
+    if (ringFd >= 0) ::close(ringFd);
+    ringFd = -1;
+    unsubmitted = 0;
+    bufferSlots = 0;
+    zeroCopySupported = false;
+}
+
+bool UringTransport::registerBuffer(uint32_t slot, const void* data, size_t length) {
+#ifdef IORING_RECVSEND_FIXED_BUF
+    if (slot >= bufferSlotCount()) return false;
+
+    struct iovec buffer;
+    buffer.iov_base = (void*)data;
+    buffer.iov_len = length;
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.data = (uint64_t)(uintptr_t)&buffer;
+    update.nr = 1;
+    return uringRegister(ringFd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) == 1;
+#else
+    (void)slot;
+    (void)data;
+    (void)length;
+    return false;
+#endif
+}
+
+// Next free submission entry, cleared; flushes the queue to the kernel if it is full
+io_uring_sqe* UringTransport::nextSqe() {
+    if (ringFd < 0) return nullptr;
+
+    unsigned tail = *sqTail;
+    if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        submit();
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) return nullptr;
+    }
+
+    unsigned index = tail & sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    return sqe;
+}
+
+// Publishes the entry returned by the last nextSqe()
+void UringTransport::queueSqe() {
+    __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+    unsubmitted++;
+}
+
+bool UringTransport::prepareSendMsg(int socket, const struct msghdr* msg, uint64_t userData) {
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe) return false;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = socket;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = userData;
+    queueSqe();
+    return true;
+}
+
+bool UringTransport::prepareSendFixed(int socket, const void* data, size_t length, uint32_t slot, uint64_t userData) {
+#ifdef IORING_RECVSEND_FIXED_BUF
+    if (slot >= bufferSlotCount()) return false;
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe) return false;
+
+    sqe->opcode = IORING_OP_SEND_ZC;
+    sqe->fd = socket;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = (uint32_t)length;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+    sqe->buf_index = (uint16_t)slot;
+    sqe->user_data = userData;
+    queueSqe();
+    return true;
+#else
+    (void)socket;
+    (void)data;
+    (void)length;
+    (void)slot;
+    (void)userData;
+    return false;
+#endif
+}
+
+bool UringTransport::prepareAccept(int listenSocket, bool multishot, uint64_t userData) {
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe) return false;
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenSocket;
+    sqe->accept_flags = SOCK_CLOEXEC;
+#ifdef IORING_ACCEPT_MULTISHOT
+    if (multishot) sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+#else
+    (void)multishot;
+#endif
+    sqe->user_data = userData;
+    queueSqe();
+    return true;
+}
+
+bool UringTransport::prepareCancel(uint64_t targetUserData) {
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe) return false;
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = targetUserData;
+    sqe->user_data = 0;
+    queueSqe();
+    return true;
+}
+
+bool UringTransport::submit() {
+    while (unsubmitted > 0) {
+        int submitted = uringEnter(ringFd, unsubmitted, 0, 0);
+        if (submitted < 0) {
+            if (errno == EINTR) continue;
+            // EBUSY/EAGAIN: completions have to be reaped first; the caller retries later
+            return false;
+        }
+        if (submitted == 0) return false;
+        unsubmitted -= std::min((unsigned)submitted, unsubmitted);
+    }
+    return true;
+}
+
+bool UringTransport::nextCompletion(Completion& completion) {
+    if (ringFd < 0) return false;
+
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+#ifdef IORING_SQ_CQ_OVERFLOW
+    // Completions that did not fit are held by the kernel until asked for
+    if (head == tail && (__atomic_load_n(sqFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)) {
+        uringEnter(ringFd, 0, 0, IORING_ENTER_GETEVENTS);
+        tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    }
+#endif
+    if (head == tail) return false;
+
+    const io_uring_cqe& cqe = cqes[head & cqMask];
+    completion.userData = cqe.user_data;
+    completion.result = cqe.res;
+    completion.more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+#ifdef IORING_CQE_F_NOTIF
+    completion.notification = (cqe.flags & IORING_CQE_F_NOTIF) != 0;
+#else
+    completion.notification = false;
+#endif
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#endif // URING_TRANSPORT_SUPPORTED
@@ -0,0 +1,106 @@
+#ifndef URING_TRANSPORT_H
+#define URING_TRANSPORT_H
+
+// Built on Linux whenever the kernel headers have io_uring; configure with
+// -DSENSOR_ENABLE_IO_URING=OFF to leave it out. Whether the running kernel allows it is
+// only known once open() is called.
+#if defined(__linux__) && !defined(SENSOR_NO_IO_URING) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #define URING_TRANSPORT_SUPPORTED 1
+    #endif
+#endif
+
+#ifdef URING_TRANSPORT_SUPPORTED
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Minimal io_uring submission/completion ring driven by raw syscalls, no liburing.
+//
+// Requests are queued with the prepare* calls and handed to the kernel together by submit(),
+// so a whole broadcast costs one io_uring_enter instead of a send() per client. Completions
+// are read straight from the shared ring. The ring fd becomes readable when completions are
+// waiting, so it can sit in a Reactor next to ordinary sockets. Not thread-safe; one ring
+// per IO thread.
+class UringTransport {
+public:
+    struct Completion {
+        uint64_t userData;
+        int32_t result;     // Byte count, accepted socket, or -errno
+        bool more;          // The request will complete again, see prepareSendFixed/prepareAccept
+        bool notification;  // Zero-copy send: the kernel no longer reads the buffer
+    };
+
+private:
+    int ringFd;
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqFlags;
+    unsigned* sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    io_uring_cqe* cqes;
+
+    unsigned unsubmitted;   // Queued since the last successful submit()
+    uint32_t bufferSlots;   // Size of the registered buffer table, 0 without one
+    bool zeroCopySupported;
+
+    io_uring_sqe* nextSqe();
+    void queueSqe();
+    bool probe(bool& zeroCopy);
+
+public:
+    UringTransport();
+    ~UringTransport();
+
+    UringTransport(const UringTransport&) = delete;
+    UringTransport& operator=(const UringTransport&) = delete;
+
+    // Fails if the kernel lacks io_uring or the send/accept/cancel operations, or policy
+    // forbids it. Registered buffers are optional: without them bufferSlotCount() is 0.
+    bool open(unsigned entries, uint32_t registeredBuffers);
+    void close();
+    bool isOpen() const { return ringFd >= 0; }
+    int fd() const { return ringFd; }
+
+    // Slots usable with prepareSendFixed(); 0 if the kernel cannot send from registered buffers
+    uint32_t bufferSlotCount() const { return zeroCopySupported ? bufferSlots : 0; }
+    // Pins [data, data + length) into a slot, replacing what it held. In-flight sends that
+    // still use the old buffer keep it alive until they complete.
+    bool registerBuffer(uint32_t slot, const void* data, size_t length);
+
+    // msg and everything it points to must stay valid until submit() returns
+    bool prepareSendMsg(int socket, const struct msghdr* msg, uint64_t userData);
+    // Zero-copy send from a registered buffer. Produces a result completion with more set,
+    // then a notification once the kernel is done with the data.
+    bool prepareSendFixed(int socket, const void* data, size_t length, uint32_t slot, uint64_t userData);
+    // Multishot keeps producing a completion per connection until one arrives without more set
+    bool prepareAccept(int listenSocket, bool multishot, uint64_t userData);
+    // Its own completion carries user data 0
+    bool prepareCancel(uint64_t targetUserData);
+
+    // Hands every queued request to the kernel. Returns false if some are still queued.
+    bool submit();
+    bool hasUnsubmitted() const { return unsubmitted > 0; }
+
+    bool nextCompletion(Completion& completion);
+};
+
+#endif // URING_TRANSPORT_SUPPORTED
+
+#endif // URING_TRANSPORT_H
@@ -0,0 +1,103 @@
+// Compression ratio and CPU cost of FrameCompressor on realistic status frames: full
+// snapshots and small deltas, in JSON and binary, for a range of fleet sizes. Every
+// compressed frame is inflated again with the shared dictionary to check it round-trips.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "BinaryProtocol.h"
+#include "FrameCompressor.h"
+#include "SensorRegistry.h"
+#include "StatusWriter.h"
+
+static const size_t LOCATION_COUNT = 64;
+
+static bool roundTrips(const std::string& original, const std::string& wrapped) {
+    if (wrapped.size() < BinaryProtocol::HEADER_SIZE || wrapped[4] != (char)BinaryProtocol::Compressed) return false;
+
+    z_stream stream = {};
+    if (inflateInit2(&stream, -15) != Z_OK) return false;
+    inflateSetDictionary(&stream, (const Bytef*)FrameCompressor::DICTIONARY, (uInt)FrameCompressor::DICTIONARY_SIZE);
+    std::string inflated(original.size() + 1, '\0');
+    stream.next_in = (Bytef*)&wrapped[BinaryProtocol::HEADER_SIZE];
+    stream.avail_in = (uInt)(wrapped.size() - BinaryProtocol::HEADER_SIZE);
+    stream.next_out = (Bytef*)&inflated[0];
+    stream.avail_out = (uInt)inflated.size();
+    int result = inflate(&stream, Z_FINISH);
+    inflated.resize(stream.total_out);
+    inflateEnd(&stream);
+    return result == Z_STREAM_END && inflated == original;
+}
+
+static void measure(const char* label, size_t sensorCount, const std::vector<std::string>& frames) {
+    size_t input = 0;
+    size_t output = 0;
+    bool ok = true;
+    std::string wrapped;
+    for (const std::string& frame : frames) {
+        if (!FrameCompressor::compress(frame.data(), frame.size(), wrapped)) ok = false;
+        ok = ok && roundTrips(frame, wrapped);
+        input += frame.size();
+        output += wrapped.size();
+    }
+
+    // Repeat until the timing covers at least ~50 ms
+    size_t rounds = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration elapsed;
+    do {
+        for (const std::string& frame : frames) {
+            FrameCompressor::compress(frame.data(), frame.size(), wrapped);
+        }
+        rounds++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(50));
+
+    double usPerFrame = std::chrono::duration<double, std::micro>(elapsed).count() / (double)(rounds * frames.size());
+    double mbPerSecond = (double)(input * rounds) / std::chrono::duration<double>(elapsed).count() / 1e6;
+    std::printf("%-16s %8zu %12.0f %12.0f %8.1fx %12.1f %10.0f %s\n", label, sensorCount,
+                (double)input / frames.size(), (double)output / frames.size(), (double)input / output,
+                usPerFrame, mbPerSecond, ok ? "" : "ROUND TRIP FAILED");
+}
+
+int main() {
+    std::printf("%-16s %8s %12s %12s %9s %12s %10s\n", "frame", "sensors", "bytes", "deflated", "ratio",
+                "us/frame", "MB/s");
+
+    std::mt19937 random(12345);
+    std::uniform_int_distribution<int> stateDist(0, 4);
+    for (size_t sensorCount : {100, 1000, 10000, 50000}) {
+        SensorRegistry registry;
+        for (size_t i = 0; i < sensorCount; ++i) {
+            registry.add("Sensor " + std::to_string(i), "Station_" + std::to_string(i % LOCATION_COUNT),
+                         (SensorState)stateDist(random));
+        }
+        std::uniform_int_distribution<SensorId> sensorDist(0, (SensorId)sensorCount - 1);
+
+        // A second of traffic: one keyframe, and deltas of a handful of changes each
+        StatusWriter writer;
+        std::vector<std::string> jsonSnapshots, binarySnapshots, jsonDeltas, binaryDeltas;
+        uint64_t sequence = 0;
+        for (int frame = 0; frame < 8; ++frame) {
+            std::vector<SensorId> changed;
+            for (int i = 0; i < 5; ++i) {
+                SensorId id = sensorDist(random);
+                registry.setState(id, (SensorState)stateDist(random));
+                changed.push_back(id);
+            }
+            ++sequence;
+            jsonDeltas.push_back(writer.writeDelta(registry, sequence, changed));
+            binaryDeltas.push_back(BinaryProtocol::encodeDelta(registry, changed, 1760700000000 + frame, sequence));
+            jsonSnapshots.push_back(writer.writeSnapshot(registry, sequence, sequence, 12));
+            binarySnapshots.push_back(BinaryProtocol::encodeSnapshot(registry, 1760700000000 + frame, sequence));
+        }
+
+        measure("JSON snapshot", sensorCount, jsonSnapshots);
+        measure("binary snapshot", sensorCount, binarySnapshots);
+        measure("JSON delta", sensorCount, jsonDeltas);
+        measure("binary delta", sensorCount, binaryDeltas);
+    }
+    return 0;
+}
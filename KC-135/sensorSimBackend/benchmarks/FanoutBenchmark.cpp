@@ -0,0 +1,391 @@
+// Load test for TCPServer fan-out: runs the server in-process, connects many loopback clients
+// (some of them deliberately slow readers) and drives state changes at a fixed rate.
+//
+// Usage: FanoutBenchmark [clients=200] [slow=10] [sensors=1000] [rate=2000] [seconds=5]
+//                        [threads=1] [readers=4] [port=18080] [backend=sockets|uring]
+//
+// Reports the time from setSensorState() to a fast client decoding the delta (percentiles),
+// delivered throughput, server CPU per client and resident memory. Clients use the binary
+// protocol. Slow readers read 256 bytes every 20 ms, so the server's slow-consumer policy
+// decides what they get; they are left out of the latency figures.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "TCPServer.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    size_t clients = 200;
+    size_t slow = 10;
+    size_t sensors = 1000;
+    double rate = 2000;       // State changes per second
+    double seconds = 5;
+    size_t threads = 1;       // Server IO threads
+    size_t readers = 4;       // Benchmark threads reading the client sockets
+    int port = 18080;
+    IOBackend backend = IOBackend::Sockets;
+};
+
+// Latencies in 1 us buckets up to 100 ms; anything slower lands in the last bucket
+struct LatencyHistogram {
+    static constexpr size_t BUCKETS = 100000;
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    int64_t maxNs = 0;
+
+    LatencyHistogram() : counts(BUCKETS + 1, 0) {}
+
+    void add(int64_t ns) {
+        size_t bucket = (size_t)std::max<int64_t>(ns / 1000, 0);
+        counts[std::min(bucket, BUCKETS)]++;
+        total++;
+        maxNs = std::max(maxNs, ns);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i <= BUCKETS; ++i) counts[i] += other.counts[i];
+        total += other.total;
+        maxNs = std::max(maxNs, other.maxNs);
+    }
+
+    // Upper edge of the bucket holding the given fraction, in microseconds
+    double percentile(double fraction) const {
+        uint64_t target = (uint64_t)(fraction * (double)total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i <= BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen > target) return (double)(i + 1);
+        }
+        return (double)BUCKETS;
+    }
+};
+
+struct Client {
+    int fd = -1;
+    bool slow = false;
+    bool switched = false;    // Past the JSON hello line
+    bool ready = false;       // Received its first snapshot
+    std::string buffer;
+    Clock::time_point nextRead;
+};
+
+struct ReaderStats {
+    LatencyHistogram latency;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    double cpuSeconds = 0;
+};
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static double threadCpuSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double processCpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1e6 +
+           (double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec / 1e6;
+}
+
+// Current resident set in MiB; 0 where /proc is unavailable
+static double residentMiB() {
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    unsigned long pages = 0, resident = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &pages, &resident);
+    std::fclose(statm);
+    return fields == 2 ? (double)resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0) : 0;
+}
+
+static uint32_t readU32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        if (equals == std::string::npos) return false;
+        std::string key = arg.substr(0, equals);
+        if (key == "backend") {
+            std::string name = arg.substr(equals + 1);
+            if (name != "sockets" && name != "uring") return false;
+            options.backend = name == "uring" ? IOBackend::IoUring : IOBackend::Sockets;
+            continue;
+        }
+        double value = std::atof(arg.c_str() + equals + 1);
+        if (key == "clients") options.clients = (size_t)value;
+        else if (key == "slow") options.slow = (size_t)value;
+        else if (key == "sensors") options.sensors = std::max<size_t>((size_t)value, 1);
+        else if (key == "rate") options.rate = value;
+        else if (key == "seconds") options.seconds = value;
+        else if (key == "threads") options.threads = std::max<size_t>((size_t)value, 1);
+        else if (key == "readers") options.readers = std::max<size_t>((size_t)value, 1);
+        else if (key == "port") options.port = (int)value;
+        else return false;
+    }
+    options.slow = std::min(options.slow, options.clients);
+    return true;
+}
+
+static int connectClient(int port, bool slow) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (slow) {
+        // A small receive window makes the backlog pile up on the server instead
+        int size = 4096;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    static const char HELLO[] = "HELLO protocol=binary\n";
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || write(fd, HELLO, sizeof(HELLO) - 1) < 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+// Decodes complete frames; deltas from fast clients are matched to the producer's change times
+static void parseFrames(Client& client, const std::vector<std::atomic<int64_t>>& changeTimes,
+                        std::atomic<size_t>& readyClients, ReaderStats& stats) {
+    size_t offset = 0;
+    if (!client.switched) {
+        size_t newline = client.buffer.find('\n');
+        if (newline == std::string::npos) return;
+        client.switched = true;
+        offset = newline + 1;
+    }
+
+    int64_t now = nowNs();
+    while (client.buffer.size() - offset >= 4) {
+        uint32_t length = readU32(&client.buffer[offset]);
+        if (client.buffer.size() - offset - 4 < length) break;
+        const char* frame = &client.buffer[offset + 4];
+        uint8_t type = (uint8_t)frame[0];
+        stats.frames++;
+
+        if (type == 2 && !client.ready) {
+            client.ready = true;
+            readyClients++;
+        } else if (type == 3 && !client.slow) {
+            // u8 type, i64 ms, u64 seq, u32 count, count x { u32 id, u8 state }
+            uint32_t count = readU32(frame + 17);
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t id = readU32(frame + 21 + 5 * i);
+                if (id < changeTimes.size()) {
+                    int64_t changed = changeTimes[id].load(std::memory_order_relaxed);
+                    if (changed > 0) stats.latency.add(now - changed);
+                }
+            }
+        }
+        offset += 4 + length;
+    }
+    client.buffer.erase(0, offset);
+}
+
+static void readClients(std::vector<Client*> clients, const std::vector<std::atomic<int64_t>>& changeTimes,
+                        std::atomic<size_t>& readyClients, std::atomic<bool>& measuring,
+                        std::atomic<bool>& stop, ReaderStats& stats) {
+    std::vector<pollfd> fds(clients.size());
+    char chunk[65536];
+    bool wasMeasuring = false;
+    double cpuStart = 0;
+
+    while (!stop) {
+        if (measuring && !wasMeasuring) {
+            // Only the measured window counts
+            wasMeasuring = true;
+            stats = ReaderStats();
+            cpuStart = threadCpuSeconds();
+        }
+
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i < clients.size(); ++i) {
+            fds[i].fd = clients[i]->fd;
+            fds[i].events = clients[i]->slow && now < clients[i]->nextRead ? 0 : POLLIN;
+            fds[i].revents = 0;
+        }
+        if (poll(fds.data(), fds.size(), 5) <= 0) continue;
+
+        for (size_t i = 0; i < clients.size(); ++i) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            Client& client = *clients[i];
+            size_t limit = client.slow ? 256 : sizeof(chunk);
+            ssize_t received = recv(client.fd, chunk, limit, 0);
+            if (received <= 0) continue;
+
+            stats.bytes += (uint64_t)received;
+            client.buffer.append(chunk, (size_t)received);
+            parseFrames(client, changeTimes, readyClients, stats);
+            if (client.slow) client.nextRead = now + std::chrono::milliseconds(20);
+        }
+    }
+    if (wasMeasuring) stats.cpuSeconds = threadCpuSeconds() - cpuStart;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [clients=N] [slow=N] [sensors=N] [rate=changes/s] [seconds=N] "
+                             "[threads=N] [readers=N] [port=N] [backend=sockets|uring]\n", argv[0]);
+        return 2;
+    }
+
+    // Two descriptors per client live in this process
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    // The server logs every connection; only the report belongs on stdout
+    std::cout.setstate(std::ios::badbit);
+
+    double baseMiB = residentMiB();
+    TCPServer server(options.port);
+    server.setIOThreads(options.threads);
+    server.setIOBackend(options.backend);
+    for (size_t i = 0; i < options.sensors; ++i) {
+        server.addSensor(Sensor("Sensor " + std::to_string(i), "Location_" + std::to_string(i % 16)));
+    }
+    if (!server.startServer()) {
+        std::fprintf(stderr, "Failed to start the server on port %d\n", options.port);
+        return 1;
+    }
+
+    std::vector<Client> clients(options.clients);
+    for (size_t i = 0; i < clients.size(); ++i) {
+        // Spread the slow readers out rather than bunching them on one reader thread
+        clients[i].slow = options.slow > 0 && i % (options.clients / options.slow) == 0 &&
+                          i / (options.clients / options.slow) < options.slow;
+        clients[i].fd = connectClient(options.port, clients[i].slow);
+        if (clients[i].fd < 0) {
+            std::fprintf(stderr, "Failed to connect client %zu\n", i);
+            return 1;
+        }
+    }
+
+    std::vector<std::atomic<int64_t>> changeTimes(options.sensors);
+    for (auto& time : changeTimes) time = 0;
+    std::atomic<size_t> readyClients(0);
+    std::atomic<bool> measuring(false);
+    std::atomic<bool> stop(false);
+
+    std::vector<ReaderStats> readerStats(options.readers);
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < options.readers; ++r) {
+        std::vector<Client*> assigned;
+        for (size_t i = r; i < clients.size(); i += options.readers) assigned.push_back(&clients[i]);
+        readers.emplace_back(readClients, assigned, std::cref(changeTimes), std::ref(readyClients),
+                             std::ref(measuring), std::ref(stop), std::ref(readerStats[r]));
+    }
+
+    // Every client has its first snapshot before the clock starts
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (readyClients < clients.size() && Clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double connectedMiB = residentMiB();
+
+    measuring = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    double processCpuStart = processCpuSeconds();
+    auto start = Clock::now();
+
+    // Producer: paced in 1 ms steps; each round over the sensors moves every one to a new state
+    double producerCpu = 0;
+    uint64_t changes = 0;
+    std::thread producer([&] {
+        double cpuStart = threadCpuSeconds();
+        auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+        for (auto now = Clock::now(); now < end; now = Clock::now()) {
+            double elapsed = std::chrono::duration<double>(now - start).count();
+            uint64_t due = (uint64_t)(elapsed * options.rate);
+            for (; changes < due; ++changes) {
+                SensorId id = (SensorId)(changes % options.sensors);
+                SensorState state = (SensorState)((changes / options.sensors + 1) % 5);
+                changeTimes[id].store(nowNs(), std::memory_order_relaxed);
+                server.setSensorState(id, state);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        producerCpu = threadCpuSeconds() - cpuStart;
+    });
+    producer.join();
+
+    // Let the last deltas arrive before the readers stop counting
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    std::vector<ClientStats> serverStats = server.getClientStats();
+    stop = true;
+    for (auto& reader : readers) reader.join();
+    double processCpu = processCpuSeconds() - processCpuStart;
+
+    ReaderStats total;
+    double readerCpu = 0;
+    for (const ReaderStats& stats : readerStats) {
+        total.latency.merge(stats.latency);
+        total.frames += stats.frames;
+        total.bytes += stats.bytes;
+        readerCpu += stats.cpuSeconds;
+    }
+    uint64_t dropped = 0;
+    for (const ClientStats& stats : serverStats) dropped += stats.droppedMessages;
+
+    // Whatever the benchmark's own threads did not use was spent by the server
+    double serverCpu = std::max(processCpu - readerCpu - producerCpu, 0.0);
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::printf("clients %zu (%zu slow), sensors %zu, %.0f changes/s for %.1f s, %zu IO thread(s), %s\n",
+                options.clients, options.slow, options.sensors, options.rate, options.seconds, options.threads,
+                options.backend == IOBackend::IoUring ? "io_uring" : "sockets");
+    std::printf("ready clients       %zu / %zu\n", readyClients.load(), options.clients);
+    std::printf("changes applied     %llu (%.0f/s)\n", (unsigned long long)changes, (double)changes / elapsed);
+    std::printf("latency us          p50 %.0f  p90 %.0f  p99 %.0f  p99.9 %.0f  max %.0f  (%llu samples)\n",
+                total.latency.percentile(0.50), total.latency.percentile(0.90), total.latency.percentile(0.99),
+                total.latency.percentile(0.999), (double)total.latency.maxNs / 1000.0,
+                (unsigned long long)total.latency.total);
+    std::printf("delivered           %.0f frames/s, %.1f MiB/s\n", (double)total.frames / elapsed,
+                (double)total.bytes / elapsed / (1024.0 * 1024.0));
+    std::printf("dropped by server   %llu frames\n", (unsigned long long)dropped);
+    std::printf("server CPU          %.1f%% of a core, %.2f us/s per client\n", 100.0 * serverCpu / elapsed,
+                1e6 * serverCpu / elapsed / (double)std::max<size_t>(options.clients, 1));
+    std::printf("memory              %.1f MiB resident with clients, %.1f KiB per client, peak %.1f MiB\n",
+                connectedMiB, 1024.0 * (connectedMiB - baseMiB) / (double)std::max<size_t>(options.clients, 1),
+                (double)usage.ru_maxrss / 1024.0);  // ru_maxrss is in KiB on Linux
+
+    for (Client& client : clients) close(client.fd);
+    server.stopServer();
+    return 0;
+}
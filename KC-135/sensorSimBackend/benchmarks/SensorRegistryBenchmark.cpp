@@ -0,0 +1,137 @@
+// Builds a fleet-sized sensor table and reports registration cost, lookup, snapshot
+// encoding time and resident memory, alongside the std::vector<Sensor> it replaced.
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "BinaryProtocol.h"
+#include "Sensor.h"
+#include "SensorRegistry.h"
+#include "StatusWriter.h"
+
+#ifdef __linux__
+    #include <unistd.h>
+#endif
+
+static const size_t SENSOR_COUNT = 100000;
+static const size_t LOCATION_COUNT = 64;
+
+// Resident set size in bytes, 0 where it cannot be read
+static size_t residentBytes() {
+#ifdef __linux__
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    unsigned long size = 0, resident = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    return fields == 2 ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+template <typename Fn>
+static double nsPerOp(size_t operations, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double)operations;
+}
+
+static std::string sensorName(size_t i) {
+    return "Sensor " + std::to_string(i);
+}
+
+static std::string sensorLocation(size_t i) {
+    return "Station_" + std::to_string(i % LOCATION_COUNT);
+}
+
+int main() {
+    std::printf("%zu sensors, %zu distinct locations\n\n", SENSOR_COUNT, LOCATION_COUNT);
+
+    // Baseline: what TCPServer used to hold
+    size_t before = residentBytes();
+    std::vector<Sensor> legacy;
+    double legacyAdd = nsPerOp(SENSOR_COUNT, [&] {
+        for (size_t i = 0; i < SENSOR_COUNT; ++i) {
+            legacy.emplace_back(sensorName(i), sensorLocation(i));
+        }
+    });
+    size_t legacyBytes = residentBytes() - before;
+
+    size_t sink = 0;
+    double legacyFind = nsPerOp(1000, [&] {
+        for (size_t i = 0; i < 1000; ++i) {
+            std::string name = sensorName((i * 7919) % SENSOR_COUNT);
+            for (const Sensor& sensor : legacy) {
+                if (sensor.getName() == name) {
+                    sink++;
+                    break;
+                }
+            }
+        }
+    });
+
+    before = residentBytes();
+    SensorRegistry registry;
+    double registryAdd = nsPerOp(SENSOR_COUNT, [&] {
+        for (size_t i = 0; i < SENSOR_COUNT; ++i) {
+            registry.add(sensorName(i), sensorLocation(i), SensorState::Off);
+        }
+    });
+    size_t registryBytes = residentBytes() - before;
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 100000; ++i) {
+        names.push_back(sensorName((i * 7919) % SENSOR_COUNT));
+    }
+    double registryFind = nsPerOp(names.size(), [&] {
+        for (const std::string& name : names) {
+            sink += registry.find(name);
+        }
+    });
+
+    const int ROUNDS = 20;
+    double binarySnapshot = nsPerOp(ROUNDS * SENSOR_COUNT, [&] {
+        for (int round = 0; round < ROUNDS; ++round) {
+            registry.setState((SensorId)round, SensorState::Degraded);
+            sink += BinaryProtocol::encodeSnapshot(registry, 0, 0).size();
+        }
+    });
+
+    StatusWriter writer;
+    uint64_t generation = 1;
+    writer.writeSnapshot(registry, generation, generation, 0);
+    double jsonSnapshot = nsPerOp(ROUNDS * SENSOR_COUNT, [&] {
+        for (int round = 0; round < ROUNDS; ++round) {
+            registry.setState((SensorId)round, (SensorState)(round % 5));
+            ++generation;
+            sink += writer.writeSnapshot(registry, generation, generation, 0).size();
+        }
+    });
+
+    double aggregate = nsPerOp(ROUNDS * SENSOR_COUNT, [&] {
+        for (int round = 0; round < ROUNDS; ++round) {
+            std::array<size_t, 8> counts = {};
+            const uint8_t* states = registry.stateData();
+            for (size_t i = 0; i < registry.size(); ++i) {
+                counts[states[i] & 7]++;
+            }
+            sink += counts[(size_t)SensorState::Degraded];
+        }
+    });
+
+    std::printf("%-34s %12s %12s\n", "", "vector", "registry");
+    std::printf("%-34s %12.1f %12.1f\n", "add (ns/sensor)", legacyAdd, registryAdd);
+    std::printf("%-34s %12.1f %12.1f\n", "find by name (ns)", legacyFind, registryFind);
+    std::printf("%-34s %12.1f %12.1f\n", "resident memory (bytes/sensor)",
+                (double)legacyBytes / SENSOR_COUNT, (double)registryBytes / SENSOR_COUNT);
+    std::printf("\n");
+    std::printf("%-34s %12.2f\n", "binary snapshot (ns/sensor)", binarySnapshot);
+    std::printf("%-34s %12.2f\n", "JSON snapshot, 1 change (ns/sensor)", jsonSnapshot);
+    std::printf("%-34s %12.2f\n", "state histogram scan (ns/sensor)", aggregate);
+    std::printf("%-34s %12.1f MB\n", "resident memory, total", residentBytes() / 1e6);
+
+    return sink == 42 ? 1 : 0;
+}
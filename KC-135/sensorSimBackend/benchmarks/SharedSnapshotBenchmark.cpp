@@ -0,0 +1,74 @@
+// Measures what a same-host consumer pays to poll the controller's shared-memory snapshots,
+// with the writer publishing continuously from another thread.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "SensorStateTable.h"
+#include "SharedSnapshotReader.h"
+#include "SharedSnapshotWriter.h"
+
+template <typename Fn>
+static double nsPerOp(size_t operations, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double)operations;
+}
+
+int main() {
+    const std::string name = "/kc135_snapshot_benchmark";
+    const size_t SENSOR_COUNTS[] = {16, 1000, 100000};
+    const size_t POLLS = 200000;
+
+    std::printf("%-10s %18s %18s %14s\n", "sensors", "generation (ns)", "full copy (ns)", "publishes");
+    for (size_t sensorCount : SENSOR_COUNTS) {
+        SensorStateTable states;
+        for (size_t i = 0; i < sensorCount; ++i) {
+            states.append(SensorState::Off);
+        }
+
+        SharedSnapshotWriter writer;
+        if (!writer.create(name, (uint32_t)sensorCount, 8)) return 1;
+        writer.publish(states, 0);
+
+        SharedSnapshotReader reader;
+        if (!reader.open(name)) return 1;
+
+        // The writer changes one sensor and republishes as fast as it can
+        std::atomic<bool> stop(false);
+        std::atomic<uint64_t> publishes(0);
+        std::thread producer([&] {
+            SensorState previous;
+            for (uint64_t i = 0; !stop; ++i) {
+                states.set(i % sensorCount, (SensorState)(i % 5), previous);
+                writer.publish(states, (int64_t)i);
+                publishes++;
+            }
+        });
+
+        uint64_t sink = 0;
+        double generation = nsPerOp(POLLS, [&] {
+            for (size_t i = 0; i < POLLS; ++i) {
+                sink += reader.latestGeneration();
+            }
+        });
+
+        SharedSnapshotData snapshot;
+        size_t copies = sensorCount > 10000 ? POLLS / 100 : POLLS;
+        double copy = nsPerOp(copies, [&] {
+            for (size_t i = 0; i < copies; ++i) {
+                reader.readLatest(snapshot);
+                sink += snapshot.states.size();
+            }
+        });
+
+        stop = true;
+        producer.join();
+        std::printf("%-10zu %18.1f %18.1f %14llu\n", sensorCount, generation, copy,
+                    (unsigned long long)publishes.load());
+        if (sink == 42) std::printf("\n");
+    }
+    return 0;
+}
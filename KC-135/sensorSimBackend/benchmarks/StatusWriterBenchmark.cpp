@@ -0,0 +1,90 @@
+// Compares the original ostringstream snapshot builder with StatusWriter.
+// Prints ns/sensor for a steady tick (one sensor changed) and an idle tick (nothing changed).
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Sensor.h"
+#include "SensorRegistry.h"
+#include "StatusWriter.h"
+
+// Baseline: TCPServer::generateStatusMessage as it was before StatusWriter
+static std::string legacySnapshot(const std::vector<Sensor>& sensors, size_t connectedClients) {
+    std::ostringstream oss;
+    auto now = std::chrono::system_clock::now();
+    auto time_t = std::chrono::system_clock::to_time_t(now);
+    std::string timestamp(std::ctime(&time_t));
+    if (!timestamp.empty() && timestamp.back() == '\n') {
+        timestamp.pop_back();
+    }
+
+    oss << "{";
+    oss << "\"timestamp\":\"" << timestamp << "\",";
+    oss << "\"server_status\":\"running\",";
+    oss << "\"connected_clients\":" << connectedClients << ",";
+    oss << "\"sensors\":[";
+    for (size_t i = 0; i < sensors.size(); ++i) {
+        if (i > 0) oss << ",";
+        oss << "{";
+        oss << "\"name\":\"" << sensors[i].getName() << "\",";
+        oss << "\"location\":\"" << sensors[i].getLocation() << "\",";
+        oss << "\"state\":\"" << sensorStateName(sensors[i].getCurrentState()) << "\"";
+        oss << "}";
+    }
+    oss << "]";
+    oss << "}\n";
+    return oss.str();
+}
+
+template <typename Fn>
+static double nsPerSensor(size_t sensorCount, Fn&& fn) {
+    // Aim for roughly 5M sensor renders per measurement
+    size_t iterations = std::max<size_t>(5, 5000000 / sensorCount);
+    size_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        sink += fn(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (sink == 42) std::printf(" ");  // Keep the work observable
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double)(iterations * sensorCount);
+}
+
+int main() {
+    std::printf("%10s %14s %14s %14s\n", "sensors", "legacy ns/s", "writer ns/s", "idle ns/s");
+
+    for (size_t sensorCount : {(size_t)10, (size_t)1000, (size_t)100000}) {
+        std::vector<Sensor> sensors;
+        SensorRegistry registry;
+        sensors.reserve(sensorCount);
+        for (size_t i = 0; i < sensorCount; ++i) {
+            sensors.emplace_back("Sensor " + std::to_string(i), "Location_" + std::to_string(i % 16));
+            registry.add(sensors.back());
+        }
+
+        double legacy = nsPerSensor(sensorCount, [&](size_t i) {
+            sensors[i % sensorCount].setCurrentState((SensorState)(i % 5));
+            return legacySnapshot(sensors, 3).size();
+        });
+
+        StatusWriter writer;
+        uint64_t generation = 0;
+        double cached = nsPerSensor(sensorCount, [&](size_t i) {
+            registry.setState((SensorId)(i % sensorCount), (SensorState)(i % 5));
+            ++generation;
+            return writer.writeSnapshot(registry, generation, generation, 3).size();
+        });
+
+        double idle = nsPerSensor(sensorCount, [&](size_t) {
+            return writer.writeSnapshot(registry, generation, generation, 3).size();
+        });
+
+        std::printf("%10zu %14.2f %14.2f %14.2f\n", sensorCount, legacy, cached, idle);
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Sends loopback datagrams at a fixed rate to a UDPSocketListener while a consumer drains it.
+// Reports how many were lost, in the kernel buffer or dropped by the listener, and the
+// process CPU time per datagram, which the receive path dominates.
+//
+// threads= sets the listener's receive threads. The datagrams come from senders= sockets,
+// since the kernel keeps each sender on one receive socket. busypoll= switches the listener to
+// busy polling with that SO_BUSY_POLL budget in microseconds, pinned from cpu= on.
+//
+// Socket and queue residency are the udp_socket_residency_ns and udp_queue_residency_ns
+// percentiles, as bucket upper bounds.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "Metrics.h"
+#include "UDPSocketListener.h"
+
+static double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct Options {
+    size_t threads = 1;
+    size_t senders = 1;
+    int receiveBuffer = 0;
+    long busyPollUs = 0;
+    int cpu = -1;
+};
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        if (equals == std::string::npos) return false;
+        std::string key = arg.substr(0, equals);
+        long value = std::atol(arg.c_str() + equals + 1);
+        if (key == "threads") options.threads = (size_t)std::max(value, 1L);
+        else if (key == "senders") options.senders = (size_t)std::max(value, 1L);
+        else if (key == "rcvbuf") options.receiveBuffer = (int)std::max(value, 0L);
+        else if (key == "busypoll") options.busyPollUs = std::max(value, 0L);
+        else if (key == "cpu") options.cpu = (int)value;
+        else return false;
+    }
+    return true;
+}
+
+// Upper bound in microseconds of the bucket holding fraction of the samples recorded between
+// the two totals
+static double percentileUs(const Metrics::HistogramTotals& before, const Metrics::HistogramTotals& after,
+                           double fraction) {
+    uint64_t count = after.count - before.count;
+    if (count == 0) return 0;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < Metrics::HISTOGRAM_BUCKETS; ++b) {
+        seen += after.buckets[b] - before.buckets[b];
+        if ((double)seen >= fraction * (double)count) return b == 0 ? 0 : (double)(1ULL << (b < 64 ? b : 63)) / 1000.0;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [threads=N] [senders=N] [rcvbuf=bytes] [busypoll=us] [cpu=N]\n", argv[0]);
+        return 2;
+    }
+
+    const int PORT = 19870;
+    const size_t PAYLOAD_SIZE = 256;
+    const double RATES[] = {20000, 50000, 100000, 200000};
+    const double DURATION_SECONDS = 2.0;
+    const int BURST = 32;
+
+    std::printf("%-12s %10s %10s %8s %16s %14s %14s\n", "target/s", "sent", "received", "lost %", "cpu ns/datagram",
+                "socket p50/99", "queue p50/99");
+    for (double rate : RATES) {
+        UDPSocketListener listener(PORT);
+        listener.setReceiveThreads(options.threads);
+        listener.setReceiveBufferSize(options.receiveBuffer);
+        listener.setBusyPoll(std::chrono::microseconds(options.busyPollUs), options.cpu);
+        Metrics::HistogramTotals socketBefore, queueBefore;
+        Metrics::histogram(MetricHistogram::UdpSocketResidencyNs, socketBefore);
+        Metrics::histogram(MetricHistogram::UdpQueueResidencyNs, queueBefore);
+        if (!listener.openSocket()) return 1;
+
+        std::atomic<bool> stop(false);
+        std::atomic<uint64_t> consumed(0);
+        std::thread consumer([&] {
+            std::vector<UdpDatagram> batch;
+            uint64_t sink = 0;
+            while (!stop || listener.hasMessages()) {
+                if (!listener.waitForMessages(std::chrono::milliseconds(10))) continue;
+                batch.clear();
+                listener.drain(batch, UDPSocketListener::RECEIVE_BATCH);
+                for (const UdpDatagram& datagram : batch) {
+                    sink += (uint8_t)datagram.data[0];
+                }
+                listener.releaseDatagrams(batch);
+                consumed += batch.size();
+            }
+            (void)sink;
+        });
+
+        std::vector<int> senders(options.senders);
+        for (int& sender : senders) {
+            sender = socket(AF_INET, SOCK_DGRAM, 0);
+        }
+        struct sockaddr_in target;
+        memset(&target, 0, sizeof(target));
+        target.sin_family = AF_INET;
+        target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        target.sin_port = htons(PORT);
+        std::vector<char> payload(PAYLOAD_SIZE, 'x');
+
+        // Bursts on a fixed schedule, like a telemetry source behind a switch
+        uint64_t total = (uint64_t)(rate * DURATION_SECONDS);
+        auto interval = std::chrono::nanoseconds((int64_t)(1e9 * BURST / rate));
+        double cpuStart = cpuSeconds();
+        auto next = std::chrono::steady_clock::now();
+        uint64_t sent = 0;
+        while (sent < total) {
+            for (int i = 0; i < BURST; ++i) {
+                int sender = senders[(size_t)(sent + i) % senders.size()];
+                if (sendto(sender, payload.data(), payload.size(), 0, (struct sockaddr*)&target, sizeof(target)) > 0) {
+                    sent++;
+                }
+            }
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        stop = true;
+        consumer.join();
+        double cpu = cpuSeconds() - cpuStart;
+        listener.closeSocket();
+        for (int sender : senders) {
+            close(sender);
+        }
+
+        Metrics::HistogramTotals socketAfter, queueAfter;
+        Metrics::histogram(MetricHistogram::UdpSocketResidencyNs, socketAfter);
+        Metrics::histogram(MetricHistogram::UdpQueueResidencyNs, queueAfter);
+
+        std::printf("%-12.0f %10llu %10llu %7.1f%% %16.0f %6.0f/%-5.0fus %6.0f/%-5.0fus\n", rate,
+                    (unsigned long long)sent, (unsigned long long)consumed.load(),
+                    100.0 * (double)(sent - consumed) / (double)sent, cpu * 1e9 / (double)sent,
+                    percentileUs(socketBefore, socketAfter, 0.5), percentileUs(socketBefore, socketAfter, 0.99),
+                    percentileUs(queueBefore, queueAfter, 0.5), percentileUs(queueBefore, queueAfter, 0.99));
+    }
+    return 0;
+}
@@ -2,12 +2,32 @@
 #include <chrono>
 #include <thread>
 #include <random>
+#include <string>
+#include <cstdlib>
 #include "SensorState.h"
 #include "Sensor.h"
 #include "UDPSocketListener.h"
 #include "TCPServer.h"
+#include "MetricsHttpServer.h"
+#include "CommandDispatcher.h"
+
+int main(int argc, char* argv[]) {
+    // Both off by default: they bound what flapping sensors cost clients, but would hold back
+    // a test stand driving sensors over UDP at a high rate
+    long coalesceMs = 0;
+    long flapHalfLifeS = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("coalesce=", 0) == 0) {
+            coalesceMs = std::atol(arg.c_str() + 9);
+        } else if (arg.rfind("flap=", 0) == 0) {
+            flapHalfLifeS = std::atol(arg.c_str() + 5);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [coalesce=<ms>] [flap=<half-life s>]" << std::endl;
+            return 2;
+        }
+    }
 
-int main() {
     std::cout << "SensorController started" << std::endl;
     
     // Create TCP server on port 8080
@@ -20,10 +40,30 @@ int main() {
     Sensor sensorD("Sensor 4", "Tail");
     
     // Add sensors to the server
-    tcpServer.addSensor(sensorA);
-    tcpServer.addSensor(sensorB);
-    tcpServer.addSensor(sensorC);
-    tcpServer.addSensor(sensorD);
+    SensorId sensorIds[] = {
+        tcpServer.addSensor(sensorA),
+        tcpServer.addSensor(sensorB),
+        tcpServer.addSensor(sensorC),
+        tcpServer.addSensor(sensorD)
+    };
+    
+    // Same-host consumers can poll snapshots from shared memory instead of going over TCP
+    if (tcpServer.enableSharedSnapshots()) {
+        std::cout << "Publishing snapshots to shared memory " << DEFAULT_SHARED_SNAPSHOT_NAME << std::endl;
+    }
+    
+    // Every state change is kept on disk for incident review with SensorJournalTool
+    if (tcpServer.enableJournal("sensor-journal")) {
+        std::cout << "Journaling state changes to sensor-journal/" << std::endl;
+    }
+    
+    // A flapping sensor reaches clients at most once a window, and not at all until it settles
+    if (coalesceMs > 0) {
+        tcpServer.setCoalescingWindow(std::chrono::milliseconds(coalesceMs));
+    }
+    if (flapHalfLifeS > 0) {
+        tcpServer.setFlapDamping(std::chrono::seconds(flapHalfLifeS));
+    }
     
     // Start the TCP server
     if (!tcpServer.startServer()) {
@@ -31,29 +71,46 @@ int main() {
         return 1;
     }
     
+    // Scrapeable runtime metrics; the sensor stream works without it
+    MetricsHttpServer metricsServer(9180);
+    metricsServer.start();
+    
+    // Test stands drive sensor states and START/STOP/SHUTDOWN commands over UDP port 8081
+    UDPSocketListener udpListener(8081);
+    udpListener.setReceiveBufferSize(4 * 1024 * 1024);
+    CommandDispatcher dispatcher(udpListener, tcpServer);
+    if (udpListener.openSocket()) {
+        dispatcher.start();
+        std::cout << "Accepting UDP commands on port 8081" << std::endl;
+    }
+    
     // Simulate sensor state changes
     std::random_device rd;
     std::mt19937 gen(rd());
     std::uniform_int_distribution<> stateDist(0, 4);
+    std::uniform_int_distribution<size_t> sensorDist(0, 3);
     
     std::cout << "TCP Server running on port 8080" << std::endl;
-    std::cout << "Broadcasting sensor status at 1Hz..." << std::endl;
-    std::cout << "Press Ctrl+C to stop" << std::endl;
+    std::cout << "Pushing sensor state changes as they happen, full snapshot every 5s..." << std::endl;
+    std::cout << "Press Ctrl+C or send SHUTDOWN to stop" << std::endl;
     
-    // Keep the main thread alive and occasionally change sensor states
+    // Keep the main thread alive and occasionally change sensor states while the simulation runs
     int counter = 0;
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::seconds(5));
-        
+    while (!dispatcher.waitForShutdown(std::chrono::seconds(5))) {
         // Occasionally change a random sensor state for demonstration
-        if (counter % 4 == 0) {
+        if (dispatcher.isSimulationRunning() && counter % 4 == 0) {
             SensorState newState = static_cast<SensorState>(stateDist(gen));
-            // This would need sensor state modification methods in a real implementation
+            tcpServer.setSensorState(sensorIds[sensorDist(gen)], newState);
             std::cout << "Simulating sensor state changes..." << std::endl;
         }
         
         counter++;
     }
     
+    dispatcher.stop();
+    udpListener.closeSocket();
+    metricsServer.stop();
+    tcpServer.stopServer();
+    std::cout << "SensorController stopped" << std::endl;
     return 0;
-}
\ No newline at end of file
+}
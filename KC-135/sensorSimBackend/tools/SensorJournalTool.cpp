@@ -0,0 +1,148 @@
+// Incident review over a state journal written by TCPServer::enableJournal.
+//
+//   SensorJournalTool <dir> [sensor=<name>] [state=<state>] [from=<time>] [to=<time>]
+//   SensorJournalTool <dir> replay=<port> [from=<time>] [to=<time>] [speed=<x>]
+//
+// The first form lists matching changes, e.g. "sensor=Sensor 4" state=Degraded answers when
+// Sensor 4 went Degraded. The second serves the sensors' states as of from= on a TCP port,
+// waits for Enter so dashboards can connect, then replays the changes speed times faster.
+// Times are unix milliseconds or local YYYY-MM-DDTHH:MM:SS.
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "JournalReader.h"
+#include "SensorState.h"
+#include "TCPServer.h"
+
+static bool parseTime(const std::string& text, int64_t& timestampNs) {
+    if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) {
+        timestampNs = std::strtoll(text.c_str(), nullptr, 10) * 1000000;
+        return true;
+    }
+    std::tm parts = {};
+    std::istringstream stream(text);
+    stream >> std::get_time(&parts, "%Y-%m-%dT%H:%M:%S");
+    if (stream.fail()) return false;
+    parts.tm_isdst = -1;
+    timestampNs = (int64_t)std::mktime(&parts) * 1000000000;
+    return true;
+}
+
+static std::string formatTime(int64_t timestampNs) {
+    std::time_t seconds = (std::time_t)(timestampNs / 1000000000);
+    std::tm parts;
+#ifdef _WIN32
+    localtime_s(&parts, &seconds);
+#else
+    localtime_r(&seconds, &parts);
+#endif
+    char text[40];
+    size_t length = std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &parts);
+    std::snprintf(text + length, sizeof(text) - length, ".%03d", (int)(timestampNs / 1000000 % 1000));
+    return text;
+}
+
+static bool parseState(const std::string& text, int& state) {
+    for (int value = 0; isValidSensorState((uint8_t)value); ++value) {
+        if (text == sensorStateName((SensorState)value)) {
+            state = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char* stateName(uint8_t state) {
+    return isValidSensorState(state) ? sensorStateName((SensorState)state) : "?";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: SensorJournalTool <dir> [sensor=<name>] [state=<state>] [from=<time>] [to=<time>]\n"
+                     "       SensorJournalTool <dir> replay=<port> [from=<time>] [to=<time>] [speed=<x>]\n"
+                     "times are unix milliseconds or local YYYY-MM-DDTHH:MM:SS" << std::endl;
+        return 2;
+    }
+
+    std::string sensorName;
+    int state = -1;
+    int64_t fromNs = INT64_MIN;
+    int64_t toNs = INT64_MAX;
+    int replayPort = 0;
+    double speed = 1.0;
+    for (int i = 2; i < argc; ++i) {
+        std::string option = argv[i];
+        size_t equals = option.find('=');
+        std::string key = option.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : option.substr(equals + 1);
+        bool ok = equals != std::string::npos;
+        if (key == "sensor") {
+            sensorName = value;
+        } else if (key == "state") {
+            ok = ok && parseState(value, state);
+        } else if (key == "from") {
+            ok = ok && parseTime(value, fromNs);
+        } else if (key == "to") {
+            ok = ok && parseTime(value, toNs);
+        } else if (key == "replay") {
+            replayPort = std::atoi(value.c_str());
+            ok = ok && replayPort > 0 && replayPort < 65536;
+        } else if (key == "speed") {
+            speed = std::atof(value.c_str());
+            ok = ok && speed >= 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "bad option: " << option << std::endl;
+            return 2;
+        }
+    }
+
+    JournalReader reader;
+    if (!reader.open(argv[1])) {
+        std::cerr << "No journal in " << argv[1] << std::endl;
+        return 1;
+    }
+    int64_t firstNs = 0, lastNs = 0;
+    if (reader.timeRange(firstNs, lastNs)) {
+        std::cout << "journal covers " << formatTime(firstNs) << " to " << formatTime(lastNs) << std::endl;
+    }
+    if (fromNs != INT64_MIN) reader.seek(fromNs);
+
+    if (replayPort == 0) {
+        JournalEntry entry;
+        size_t matched = 0;
+        while (reader.next(entry) && entry.timestampNs <= toNs) {
+            if (state >= 0 && entry.newState != state) continue;
+            if (!sensorName.empty() && (!entry.sensor || entry.sensor->name != sensorName)) continue;
+
+            std::cout << formatTime(entry.timestampNs) << "  ";
+            if (entry.sensor) {
+                std::cout << entry.sensor->name << " (" << entry.sensor->location << ")";
+            } else {
+                std::cout << "sensor #" << entry.sensorId;
+            }
+            std::cout << "  " << stateName(entry.oldState) << " -> " << stateName(entry.newState) << std::endl;
+            matched++;
+        }
+        std::cout << matched << " change(s)" << std::endl;
+        return 0;
+    }
+
+    TCPServer server(replayPort);
+    if (!server.startServer()) return 1;
+    std::cout << "Press Enter to start the replay" << std::endl;
+    std::string line;
+    std::getline(std::cin, line);
+
+    size_t applied = reader.replay(server, toNs, speed);
+    std::cout << "Replayed " << applied << " change(s); press Enter to stop" << std::endl;
+    std::getline(std::cin, line);
+    server.stopServer();
+    return 0;
+}